@@ -36,6 +36,7 @@ SOFTWARE.
 #include "SPIdev.h"
 
 /** Default constructor.
+ * The device is not ready if its settings find no room in the profile table.
  * @param slavePin arduino pin for spi slave sensor selection
  * @param settings SPISettings from https://www.arduino.cc/en/Reference/SPISettings
  * @param bitOrder dataOrder: MSBFIRST or LSBFIRST from https://www.arduino.cc/en/Reference/SPISettings
@@ -43,20 +44,100 @@ SOFTWARE.
 SPIdev::SPIdev(int8_t slavePin, SPISettings settings, uint8_t bitOrder) {
     // Slave Pin
     slave = slavePin;
-    // set the slaveSelectPin as an output:
+    #ifdef __AVR__
+        csPort = digitalPinToPort(slave);
+        csMask = digitalPinToBitMask(slave);
+    #endif
+    // set the slaveSelectPin as an output, de-selected until the first transaction:
+    digitalWrite(slave, HIGH);
     pinMode(slave, OUTPUT);
     // initialize SPI:
     SPI.begin();
     // Settings
-    settings = settings;
-    dataOrder = bitOrder;
+    uint8_t index = addProfile(settings);
+    selectable = true;
+    ready = (index != SPIDEV_NO_PROFILE);
+    profile = ready ? index : 0;
+    dataOrder = (bitOrder == LSBFIRST) ? LSBFIRST : MSBFIRST;
+    selector = 0;
+    #ifdef SPIDEV_CRC
+        crcSeed = 0x00;
+        crcErrors = 0;
+        crcFailures = 0;
+    #endif
+}
+
+/** Constructor for a device selected through a chip-select strategy.
+ * The device is not ready if its settings or its strategy find no room in
+ * their table, or if the strategy does not accept its address.
+ * @param select Strategy driving the chip-select line of the device
+ * @param address Address of the device on the strategy (e.g. decoder output)
+ * @param settings SPISettings from https://www.arduino.cc/en/Reference/SPISettings
+ * @param bitOrder dataOrder: MSBFIRST or LSBFIRST from https://www.arduino.cc/en/Reference/SPISettings
+ */
+SPIdev::SPIdev(SPIdevSelect &select, uint8_t address, SPISettings settings, uint8_t bitOrder) {
+    slave = address;
+    #ifdef __AVR__
+        csPort = 0;
+        csMask = 0;
+    #endif
+    // initialize SPI:
+    SPI.begin();
+    // Settings
+    uint8_t index = addProfile(settings);
+    uint8_t strategy = addSelector(&select);
+    selectable = (strategy != SPIDEV_NO_SELECTOR && select.accepts(address));
+    ready = (index != SPIDEV_NO_PROFILE && selectable);
+    profile = (index != SPIDEV_NO_PROFILE) ? index : 0;
+    dataOrder = (bitOrder == LSBFIRST) ? LSBFIRST : MSBFIRST;
+    // a strategy refused by the full table must not fall back to the pin path
+    selector = (strategy != SPIDEV_NO_SELECTOR) ? strategy + 1 : 1;
+    #ifdef SPIDEV_CRC
+        crcSeed = 0x00;
+        crcErrors = 0;
+        crcFailures = 0;
+    #endif
 }
 
 /** Set new SPISettings for the sensor
+ * A device left not ready by a full profile table becomes ready once its new
+ * settings find room.
  * @param settings SPISettings from https://www.arduino.cc/en/Reference/SPISettings
+ * @return Status of operation (false = profile table full, settings unchanged,
+ * or the device cannot be selected)
+ */
+bool SPIdev::setSPISettings(SPISettings settings) {
+    uint8_t index = addProfile(settings);
+    if (index == SPIDEV_NO_PROFILE) return false;
+    profile = index;
+    ready = selectable;
+    return ready;
+}
+
+/** Table of the settings profiles shared by all devices.
+ * It is built on first use, so devices constructed as globals can register
+ * their settings regardless of the initialization order of the sketch.
+ * @return Array of SPIDEV_MAX_PROFILES settings
  */
-void SPIdev::setSPISettings(SPISettings settings) {
-    settings = settings;
+SPISettings *SPIdev::profiles() {
+    static SPISettings table[SPIDEV_MAX_PROFILES];
+    return table;
+}
+
+/** Find the profile with the given settings, adding it if there is none.
+ * Profiles in use are never replaced, so new settings are refused once the
+ * table is full.
+ * @param settings Settings to look for
+ * @return Index of the profile (SPIDEV_NO_PROFILE = table full)
+ */
+uint8_t SPIdev::addProfile(const SPISettings &settings) {
+    SPISettings *table = profiles();
+    for (uint8_t i = 0; i < profileCount; i++) {
+        if (memcmp(&table[i], &settings, sizeof(SPISettings)) == 0) return i;
+    }
+    if (profileCount >= SPIDEV_MAX_PROFILES) return SPIDEV_NO_PROFILE;
+    table[profileCount] = settings;
+    return profileCount++;
 }
 
 /** Read a single bit from an 8-bit device register.
@@ -132,24 +213,6 @@ int8_t SPIdev::readBitsW(uint8_t regAddr, uint8_t bitStart, uint8_t length, uint
     return count;
 }
 
-/** Read single byte from an 8-bit device register.
- * @param regAddr Register regAddr to read from
- * @param data Container for byte value read from device
- * @return Status of read operation (true = success)
- */
-int8_t SPIdev::readByte(uint8_t regAddr, uint8_t *data) {
-    return readBytes(regAddr, 1, data);
-}
-
-/** Read single word from a 16-bit device register.
- * @param regAddr Register regAddr to read from
- * @param data Container for word value read from device
- * @return Status of read operation (true = success)
- */
-int8_t SPIdev::readWord(uint8_t regAddr, uint16_t *data) {
-    return readWords(regAddr, 1, data);
-}
-
 /** Read multiple bytes from an 8-bit device register.
  * @param regAddr First register regAddr to read from
  * @param length Number of bytes to read
@@ -157,8 +220,7 @@ int8_t SPIdev::readWord(uint8_t regAddr, uint16_t *data) {
  * @return Number of bytes read (-1 indicates failure)
  */
 int8_t SPIdev::readBytes(uint8_t regAddr, uint8_t length, uint8_t *data) {
-
-    int8_t count = 0;
+    if (!ready) return -1;
 
     #ifdef SPIDEV_SERIAL_DEBUG
         Serial.print("SPI reading ");
@@ -168,92 +230,202 @@ int8_t SPIdev::readBytes(uint8_t regAddr, uint8_t length, uint8_t *data) {
         Serial.print("...");
     #endif
 
-    SPI.beginTransaction(settings);
+    select(regAddr | READ, length);
 
-    // take the slave pin low to select the chip:
-    digitalWrite(slave, LOW);
+    transfer(regAddr | READ); // specify the starting register address
+    memset(data, 0x00, length);
+    transfer(data, length); // read the data in a single burst
 
-    SPI.transfer(regAddr | READ); // specify the starting register address
-    for(; count < length; count++){
-        data[count] = SPI.transfer(0x00); // read the data
-
-        #ifdef SPIDEV_SERIAL_DEBUG
-            Serial.print(data[count], HEX);
-            if (count + 1 < length) Serial.print(" ");
-        #endif
-    }
-
-    // take the slave pin high to de-select the chip:
-    digitalWrite(slave, HIGH);
-
-    SPI.endTransaction();
+    deselect();
 
     #ifdef SPIDEV_SERIAL_DEBUG
+        for (uint8_t i = 0; i < length; i++) {
+            Serial.print(data[i], HEX);
+            if (i + 1 < length) Serial.print(" ");
+        }
         Serial.print(". Done (");
-        Serial.print(count, DEC);
+        Serial.print(length, DEC);
         Serial.println(" read).");
     #endif
 
-    return count;
+    return length;
 }
 
 /** Read multiple words from a 16-bit device register.
+ * Words are received MSB first unless dataOrder is LSBFIRST, in which case
+ * the low byte comes first on the wire.
  * @param regAddr First register regAddr to read from
  * @param length Number of words to read
  * @param data Buffer to store read data in
  * @return Number of words read (-1 indicates failure)
  */
 int8_t SPIdev::readWords(uint8_t regAddr, uint8_t length, uint16_t *data) {
-
-    int8_t count = 0;
+    if (!ready) return -1;
 
     #ifdef SPIDEV_SERIAL_DEBUG
         Serial.print("SPI reading ");
         Serial.print(length, DEC);
-        Serial.print(" bytes from 0x");
+        Serial.print(" words from 0x");
         Serial.print(regAddr, HEX);
         Serial.print("...");
     #endif
 
-    SPI.beginTransaction(settings);
-
-    // take the slave pin low to select the chip:
-    digitalWrite(slave, LOW);
-
-    // SPI subsystem uses internal buffer that breaks with large data requests
-    // so if user requests more than BUFFER_LENGTH bytes, we have to do it in
-    // smaller chunks instead of all at once
-    bool msb = dataOrder; // starts with MSB, then LSB
-    SPI.transfer(regAddr | READ); // specify the starting register address
-    for(; count < length;){
-        if (msb == MSBFIRST) {
-            // first byte is bits 15-8 (MSb=15)
-            data[count] = SPI.transfer(0x00) << 8; // read the data
-            msb = LSBFIRST;
-        } else {
-            // second byte is bits 7-0 (LSb=0)
-            data[count] |= SPI.transfer(0x00); // read the data
-            #ifdef SPIDEV_SERIAL_DEBUG
-                Serial.print(data[count], HEX);
-                if (count + 1 < length) Serial.print(" ");
-            #endif
-            count++;
-            msb = MSBFIRST;
-        }
-    }
+    select(regAddr | READ, (uint16_t) length * 2);
 
-    // take the slave pin high to de-select the chip:
-    digitalWrite(slave, HIGH);
+    // read the raw bytes straight into the caller buffer, then decode them in
+    // place: word i only ever depends on bytes 2i and 2i+1
+    uint8_t *raw = (uint8_t *) data;
+    transfer(regAddr | READ); // specify the starting register address
+    memset(raw, 0x00, (size_t) length * 2);
+    transfer(raw, (size_t) length * 2);
 
-    SPI.endTransaction();
+    deselect();
+
+    for (uint8_t i = 0; i < length; i++) {
+        uint8_t first = raw[2 * i];
+        uint8_t second = raw[2 * i + 1];
+        data[i] = (dataOrder == LSBFIRST) ? ((uint16_t) second << 8) | first
+                                          : ((uint16_t) first << 8) | second;
+        #ifdef SPIDEV_SERIAL_DEBUG
+            Serial.print(data[i], HEX);
+            if (i + 1 < length) Serial.print(" ");
+        #endif
+    }
 
     #ifdef SPIDEV_SERIAL_DEBUG
         Serial.print(". Done (");
-        Serial.print(count, DEC);
+        Serial.print(length, DEC);
         Serial.println(" read).");
     #endif
 
-    return count;
+    return length;
+}
+
+#ifdef SPIDEV_CRC
+/** Read multiple bytes followed by a CRC-8 byte from an 8-bit device register.
+ * The CRC (polynomial 0x07, initial value crcSeed) covers the data bytes and is
+ * read in the same burst. On a mismatch the read is re-issued up to crcRetries
+ * times, counting each bad frame in crcErrors.
+ * @param regAddr First register regAddr to read from
+ * @param length Number of data bytes to read (without the CRC byte)
+ * @param data Buffer to store read data in
+ * @return Number of bytes read (-1 indicates CRC failure after all retries)
+ */
+int8_t SPIdev::readBytesCRC(uint8_t regAddr, uint8_t length, uint8_t *data) {
+    if (!ready) return -1;
+    for (uint8_t attempt = 0; attempt <= crcRetries; attempt++) {
+        select(regAddr | READ, (uint16_t) length + 1);
+
+        transfer(regAddr | READ); // specify the starting register address
+        memset(data, 0x00, length);
+        transfer(data, length); // read the data in a single burst
+        uint8_t crc = transfer(0x00); // read the CRC byte
+
+        deselect();
+
+        if (crc8(data, length, crcSeed) == crc) return length;
+
+        crcErrors++;
+
+        #ifdef SPIDEV_SERIAL_DEBUG
+            Serial.print("SPI CRC mismatch reading 0x");
+            Serial.print(regAddr, HEX);
+            Serial.println(attempt < crcRetries ? ", retrying." : ", giving up.");
+        #endif
+    }
+
+    crcFailures++;
+    return -1;
+}
+
+#endif
+
+/** Read signed 16-bit channels several times and average them.
+ * All the bursts are done back to back within a single bus transaction,
+ * toggling only the slave pin between them, and each channel is accumulated
+ * in a 32-bit integer straight from the received bytes.
+ * @param regAddr First register regAddr to read from
+ * @param length Number of channels (words) to read, up to SPIDEV_OVERSAMPLE_MAX_CHANNELS
+ * @param samples Number of bursts to average (at least 1)
+ * @param average Buffer to store the rounded average of each channel in
+ * @param minimum Buffer to store the minimum of each channel in (optional)
+ * @param maximum Buffer to store the maximum of each channel in (optional)
+ * @return Number of channels read (-1 indicates failure)
+ */
+int8_t SPIdev::readWordsOversampled(uint8_t regAddr, uint8_t length, uint8_t samples, int16_t *average, int16_t *minimum, int16_t *maximum) {
+    if (!ready || length > SPIDEV_OVERSAMPLE_MAX_CHANNELS || samples == 0) return -1;
+
+    int32_t sum[SPIDEV_OVERSAMPLE_MAX_CHANNELS];
+    int16_t lo[SPIDEV_OVERSAMPLE_MAX_CHANNELS];
+    int16_t hi[SPIDEV_OVERSAMPLE_MAX_CHANNELS];
+    uint8_t *raw = transferBuffer;
+    // offsets of the high and low byte of each word in the burst
+    uint8_t h = (dataOrder == LSBFIRST) ? 1 : 0;
+    uint8_t l = h ^ 1;
+
+    select(regAddr | READ, (uint16_t) length * 2 * samples);
+
+    for (uint8_t n = 0; n < samples; n++) {
+        if (n > 0) {
+            // restart the burst without releasing the bus
+            csHigh();
+            csLow();
+        }
+        transfer(regAddr | READ); // specify the starting register address
+        memset(raw, 0x00, (size_t) length * 2);
+        transfer(raw, (size_t) length * 2);
+
+        for (uint8_t i = 0; i < length; i++) {
+            int16_t v = (int16_t) (((uint16_t) raw[2 * i + h] << 8) | raw[2 * i + l]);
+            if (n == 0) {
+                sum[i] = lo[i] = hi[i] = v;
+            } else {
+                sum[i] += v;
+                if (v < lo[i]) lo[i] = v;
+                if (v > hi[i]) hi[i] = v;
+            }
+        }
+    }
+
+    deselect();
+
+    for (uint8_t i = 0; i < length; i++) {
+        // round half away from zero
+        int32_t half = (sum[i] < 0) ? -(int32_t) (samples / 2) : samples / 2;
+        average[i] = (int16_t) ((sum[i] + half) / samples);
+        if (minimum != NULL) minimum[i] = lo[i];
+        if (maximum != NULL) maximum[i] = hi[i];
+    }
+
+    return length;
+}
+
+/** Exchange raw frames with the device in a single transaction, full duplex.
+ * The chip select is released between frames, for devices that start a
+ * conversion or latch a command on its edges (e.g. pipelined ADCs).
+ * @param data Frames to send, overwritten with the frames received
+ * @param frameSize Number of bytes per frame
+ * @param frames Number of frames
+ * @param gapMicros Time the chip select is held high between frames
+ * @return Status of operation (true = success)
+ */
+bool SPIdev::transferFrames(uint8_t *data, uint8_t frameSize, uint8_t frames, uint16_t gapMicros) {
+    if (!ready) return false;
+    if (frameSize == 0 || frames == 0) return true;
+
+    select(data[0], (uint16_t) frameSize * frames - 1);
+
+    for (uint8_t n = 0; n < frames; n++) {
+        if (n > 0) {
+            csHigh();
+            if (gapMicros > 0) delayMicroseconds(gapMicros);
+            csLow();
+        }
+        transfer(data + (uint16_t) n * frameSize, frameSize);
+    }
+
+    deselect();
+    return true;
 }
 
 /** write a single bit in an 8-bit device register.
@@ -338,24 +510,6 @@ bool SPIdev::writeBitsW(uint8_t regAddr, uint8_t bitStart, uint8_t length, uint1
     }
 }
 
-/** Write single byte to an 8-bit device register.
- * @param regAddr Register address to write to
- * @param data New byte value to write
- * @return Status of operation (true = success)
- */
-bool SPIdev::writeByte(uint8_t regAddr, uint8_t data) {
-    return writeBytes(regAddr, 1, &data);
-}
-
-/** Write single word to a 16-bit device register.
- * @param regAddr Register address to write to
- * @param data New word value to write
- * @return Status of operation (true = success)
- */
-bool SPIdev::writeWord(uint8_t regAddr, uint16_t data) {
-    return writeWords(regAddr, 1, &data);
-}
-
 /** Write multiple bytes to an 8-bit device register.
  * @param regAddr First register address to write to
  * @param length Number of bytes to write
@@ -363,6 +517,7 @@ bool SPIdev::writeWord(uint8_t regAddr, uint16_t data) {
  * @return Status of operation (true = success)
  */
 bool SPIdev::writeBytes(uint8_t regAddr, uint8_t length, uint8_t* data) {
+    if (!ready) return false;
 
     #ifdef SPIDEV_SERIAL_DEBUG
         Serial.print("SPI writing ");
@@ -374,25 +529,26 @@ bool SPIdev::writeBytes(uint8_t regAddr, uint8_t length, uint8_t* data) {
 
     uint8_t status = 0;
 
-    SPI.beginTransaction(settings);
-
-    // take the slave pin low to select the chip:
-    digitalWrite(slave, LOW);
-
-    SPI.transfer(regAddr); // specify the starting register address
-    for (uint8_t i = 0; i < length; i++) {
-        #ifdef SPIDEV_SERIAL_DEBUG
+    #ifdef SPIDEV_SERIAL_DEBUG
+        for (uint8_t i = 0; i < length; i++) {
             Serial.print(data[i], HEX);
             if (i + 1 < length) Serial.print(" ");
-        #endif
+        }
+    #endif
 
-        SPI.transfer((uint8_t) data[i]); // send the data
-    }
+    select(regAddr, length);
 
-    // take the slave pin high to de-select the chip:
-    digitalWrite(slave, HIGH);
+    transfer(regAddr); // specify the starting register address
+    // send the data in bursts through the shared buffer, as a burst overwrites
+    // what it sends with what it receives
+    for (uint8_t done = 0; done < length; ) {
+        uint8_t chunk = min((uint8_t) (length - done), (uint8_t) SPIDEV_BUFFER_LENGTH);
+        memcpy(transferBuffer, data + done, chunk);
+        transfer(transferBuffer, chunk);
+        done += chunk;
+    }
 
-    SPI.endTransaction();
+    deselect();
 
     #ifdef SPIDEV_SERIAL_DEBUG
         Serial.println(". Done.");
@@ -402,12 +558,14 @@ bool SPIdev::writeBytes(uint8_t regAddr, uint8_t length, uint8_t* data) {
 }
 
 /** Write multiple words to a 16-bit device register.
+ * Words are sent MSB first unless dataOrder is LSBFIRST.
  * @param regAddr First register address to write to
  * @param length Number of words to write
  * @param data Buffer to copy new data from
  * @return Status of operation (true = success)
  */
 bool SPIdev::writeWords(uint8_t regAddr, uint8_t length, uint16_t* data) {
+    if (!ready) return false;
     #ifdef SPIDEV_SERIAL_DEBUG
         Serial.print("SPI writing ");
         Serial.print(length, DEC);
@@ -417,25 +575,30 @@ bool SPIdev::writeWords(uint8_t regAddr, uint8_t length, uint16_t* data) {
     #endif
     uint8_t status = 0;
 
-    SPI.beginTransaction(settings);
-
-    // take the slave pin low to select the chip:
-    digitalWrite(slave, LOW);
-
-    SPI.transfer(regAddr); // specify the starting register address
-    for (uint8_t i = 0; i < length; i++) {
-        #ifdef SPIDEV_SERIAL_DEBUG
+    #ifdef SPIDEV_SERIAL_DEBUG
+        for (uint8_t i = 0; i < length; i++) {
             Serial.print(data[i], HEX);
             if (i + 1 < length) Serial.print(" ");
-        #endif
-        SPI.transfer((uint8_t)(data[i] >> 8));     // send MSB
-        SPI.transfer((uint8_t)data[i]);          // send LSB
-    }
+        }
+    #endif
 
-    // take the slave pin high to de-select the chip:
-    digitalWrite(slave, HIGH);
+    select(regAddr, (uint16_t) length * 2);
+
+    transfer(regAddr); // specify the starting register address
+    // encode the words into the shared buffer and send them in bursts
+    uint8_t h = (dataOrder == LSBFIRST) ? 1 : 0;
+    uint8_t l = h ^ 1;
+    for (uint8_t done = 0; done < length; ) {
+        uint8_t chunk = min((uint8_t) (length - done), (uint8_t) (SPIDEV_BUFFER_LENGTH / 2));
+        for (uint8_t i = 0; i < chunk; i++) {
+            transferBuffer[2 * i + h] = (uint8_t) (data[done + i] >> 8);
+            transferBuffer[2 * i + l] = (uint8_t) data[done + i];
+        }
+        transfer(transferBuffer, (size_t) chunk * 2);
+        done += chunk;
+    }
 
-    SPI.endTransaction();
+    deselect();
 
     #ifdef SPIDEV_SERIAL_DEBUG
         Serial.println(". Done.");
@@ -444,60 +607,397 @@ bool SPIdev::writeWords(uint8_t regAddr, uint8_t length, uint16_t* data) {
     return status == 0;
 }
 
-/** Default timeout value for read operations.
- * Set this to 0 to disable timeout detection.
+#ifdef SPIDEV_SOFT_LSBFIRST
+// Bit-reversal lookup table (bit 0 <-> bit 7, bit 1 <-> bit 6, ...)
+static const uint8_t reverseTable[256] PROGMEM = {
+    0x00, 0x80, 0x40, 0xC0, 0x20, 0xA0, 0x60, 0xE0, 0x10, 0x90, 0x50, 0xD0, 0x30, 0xB0, 0x70, 0xF0,
+    0x08, 0x88, 0x48, 0xC8, 0x28, 0xA8, 0x68, 0xE8, 0x18, 0x98, 0x58, 0xD8, 0x38, 0xB8, 0x78, 0xF8,
+    0x04, 0x84, 0x44, 0xC4, 0x24, 0xA4, 0x64, 0xE4, 0x14, 0x94, 0x54, 0xD4, 0x34, 0xB4, 0x74, 0xF4,
+    0x0C, 0x8C, 0x4C, 0xCC, 0x2C, 0xAC, 0x6C, 0xEC, 0x1C, 0x9C, 0x5C, 0xDC, 0x3C, 0xBC, 0x7C, 0xFC,
+    0x02, 0x82, 0x42, 0xC2, 0x22, 0xA2, 0x62, 0xE2, 0x12, 0x92, 0x52, 0xD2, 0x32, 0xB2, 0x72, 0xF2,
+    0x0A, 0x8A, 0x4A, 0xCA, 0x2A, 0xAA, 0x6A, 0xEA, 0x1A, 0x9A, 0x5A, 0xDA, 0x3A, 0xBA, 0x7A, 0xFA,
+    0x06, 0x86, 0x46, 0xC6, 0x26, 0xA6, 0x66, 0xE6, 0x16, 0x96, 0x56, 0xD6, 0x36, 0xB6, 0x76, 0xF6,
+    0x0E, 0x8E, 0x4E, 0xCE, 0x2E, 0xAE, 0x6E, 0xEE, 0x1E, 0x9E, 0x5E, 0xDE, 0x3E, 0xBE, 0x7E, 0xFE,
+    0x01, 0x81, 0x41, 0xC1, 0x21, 0xA1, 0x61, 0xE1, 0x11, 0x91, 0x51, 0xD1, 0x31, 0xB1, 0x71, 0xF1,
+    0x09, 0x89, 0x49, 0xC9, 0x29, 0xA9, 0x69, 0xE9, 0x19, 0x99, 0x59, 0xD9, 0x39, 0xB9, 0x79, 0xF9,
+    0x05, 0x85, 0x45, 0xC5, 0x25, 0xA5, 0x65, 0xE5, 0x15, 0x95, 0x55, 0xD5, 0x35, 0xB5, 0x75, 0xF5,
+    0x0D, 0x8D, 0x4D, 0xCD, 0x2D, 0xAD, 0x6D, 0xED, 0x1D, 0x9D, 0x5D, 0xDD, 0x3D, 0xBD, 0x7D, 0xFD,
+    0x03, 0x83, 0x43, 0xC3, 0x23, 0xA3, 0x63, 0xE3, 0x13, 0x93, 0x53, 0xD3, 0x33, 0xB3, 0x73, 0xF3,
+    0x0B, 0x8B, 0x4B, 0xCB, 0x2B, 0xAB, 0x6B, 0xEB, 0x1B, 0x9B, 0x5B, 0xDB, 0x3B, 0xBB, 0x7B, 0xFB,
+    0x07, 0x87, 0x47, 0xC7, 0x27, 0xA7, 0x67, 0xE7, 0x17, 0x97, 0x57, 0xD7, 0x37, 0xB7, 0x77, 0xF7,
+    0x0F, 0x8F, 0x4F, 0xCF, 0x2F, 0xAF, 0x6F, 0xEF, 0x1F, 0x9F, 0x5F, 0xDF, 0x3F, 0xBF, 0x7F, 0xFF
+};
+#endif
+
+// CRC-8 lookup table, polynomial 0x07 (x^8 + x^2 + x + 1)
+static const uint8_t crc8Table[256] PROGMEM = {
+    0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15, 0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D,
+    0x70, 0x77, 0x7E, 0x79, 0x6C, 0x6B, 0x62, 0x65, 0x48, 0x4F, 0x46, 0x41, 0x54, 0x53, 0x5A, 0x5D,
+    0xE0, 0xE7, 0xEE, 0xE9, 0xFC, 0xFB, 0xF2, 0xF5, 0xD8, 0xDF, 0xD6, 0xD1, 0xC4, 0xC3, 0xCA, 0xCD,
+    0x90, 0x97, 0x9E, 0x99, 0x8C, 0x8B, 0x82, 0x85, 0xA8, 0xAF, 0xA6, 0xA1, 0xB4, 0xB3, 0xBA, 0xBD,
+    0xC7, 0xC0, 0xC9, 0xCE, 0xDB, 0xDC, 0xD5, 0xD2, 0xFF, 0xF8, 0xF1, 0xF6, 0xE3, 0xE4, 0xED, 0xEA,
+    0xB7, 0xB0, 0xB9, 0xBE, 0xAB, 0xAC, 0xA5, 0xA2, 0x8F, 0x88, 0x81, 0x86, 0x93, 0x94, 0x9D, 0x9A,
+    0x27, 0x20, 0x29, 0x2E, 0x3B, 0x3C, 0x35, 0x32, 0x1F, 0x18, 0x11, 0x16, 0x03, 0x04, 0x0D, 0x0A,
+    0x57, 0x50, 0x59, 0x5E, 0x4B, 0x4C, 0x45, 0x42, 0x6F, 0x68, 0x61, 0x66, 0x73, 0x74, 0x7D, 0x7A,
+    0x89, 0x8E, 0x87, 0x80, 0x95, 0x92, 0x9B, 0x9C, 0xB1, 0xB6, 0xBF, 0xB8, 0xAD, 0xAA, 0xA3, 0xA4,
+    0xF9, 0xFE, 0xF7, 0xF0, 0xE5, 0xE2, 0xEB, 0xEC, 0xC1, 0xC6, 0xCF, 0xC8, 0xDD, 0xDA, 0xD3, 0xD4,
+    0x69, 0x6E, 0x67, 0x60, 0x75, 0x72, 0x7B, 0x7C, 0x51, 0x56, 0x5F, 0x58, 0x4D, 0x4A, 0x43, 0x44,
+    0x19, 0x1E, 0x17, 0x10, 0x05, 0x02, 0x0B, 0x0C, 0x21, 0x26, 0x2F, 0x28, 0x3D, 0x3A, 0x33, 0x34,
+    0x4E, 0x49, 0x40, 0x47, 0x52, 0x55, 0x5C, 0x5B, 0x76, 0x71, 0x78, 0x7F, 0x6A, 0x6D, 0x64, 0x63,
+    0x3E, 0x39, 0x30, 0x37, 0x22, 0x25, 0x2C, 0x2B, 0x06, 0x01, 0x08, 0x0F, 0x1A, 0x1D, 0x14, 0x13,
+    0xAE, 0xA9, 0xA0, 0xA7, 0xB2, 0xB5, 0xBC, 0xBB, 0x96, 0x91, 0x98, 0x9F, 0x8A, 0x8D, 0x84, 0x83,
+    0xDE, 0xD9, 0xD0, 0xD7, 0xC2, 0xC5, 0xCC, 0xCB, 0xE6, 0xE1, 0xE8, 0xEF, 0xFA, 0xFD, 0xF4, 0xF3
+};
+
+/** Compute the CRC-8 (polynomial 0x07) of a buffer, one table lookup per byte.
+ * @param data Buffer to compute the CRC of
+ * @param length Number of bytes in the buffer
+ * @param crc Initial CRC value, or the CRC of the previous chunk to continue it
+ * @return CRC-8 of the buffer
  */
-//uint16_t SPIdev::readTimeout = SPIDEV_DEFAULT_READ_TIMEOUT;
-uint16_t SPIdev::readTimeout = 0;
-
-
-/* STUBS */
-int8_t SPIdev::readBit(uint8_t devAddr, uint8_t regAddr, uint8_t bitNum, uint8_t *data, uint16_t timeout) {
-    return readBit(regAddr, bitNum, data);
-}
-int8_t SPIdev::readBitW(uint8_t devAddr, uint8_t regAddr, uint8_t bitNum, uint16_t *data, uint16_t timeout) {
-    return readBitW(regAddr, bitNum, data);
-}
-int8_t SPIdev::readBits(uint8_t devAddr, uint8_t regAddr, uint8_t bitStart, uint8_t length, uint8_t *data, uint16_t timeout) {
-    return readBits(regAddr, bitStart, length, data);
-}
-int8_t SPIdev::readBitsW(uint8_t devAddr, uint8_t regAddr, uint8_t bitStart, uint8_t length, uint16_t *data, uint16_t timeout) {
-    return readBitsW(regAddr, bitStart, length, data);
+uint8_t SPIdev::crc8(const uint8_t *data, size_t length, uint8_t crc) {
+    for (size_t i = 0; i < length; i++) {
+        crc = pgm_read_byte(&crc8Table[crc ^ data[i]]);
+    }
+    return crc;
 }
-int8_t SPIdev::readByte(uint8_t devAddr, uint8_t regAddr, uint8_t *data, uint16_t timeout) {
-    return readByte(regAddr, data);
+
+/** Reverse the bit order of a byte (bit 0 <-> bit 7, bit 1 <-> bit 6, ...).
+ * @param data Byte to reverse
+ * @return Bit-reversed byte
+ */
+uint8_t SPIdev::reverseBits(uint8_t data) {
+    #ifdef SPIDEV_SOFT_LSBFIRST
+        return pgm_read_byte(&reverseTable[data]);
+    #else
+        data = (data >> 4) | (data << 4);
+        data = ((data & 0xCC) >> 2) | ((data & 0x33) << 2);
+        return ((data & 0xAA) >> 1) | ((data & 0x55) << 1);
+    #endif
 }
-int8_t SPIdev::readWord(uint8_t devAddr, uint8_t regAddr, uint16_t *data, uint16_t timeout) {
-    return readWord(regAddr, data);
+
+/** Reverse the bit order of every byte in a buffer, in place.
+ * @param data Buffer to reverse
+ * @param length Number of bytes in the buffer
+ */
+void SPIdev::reverseBits(uint8_t *data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        data[i] = reverseBits(data[i]);
+    }
 }
-int8_t SPIdev::readBytes(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8_t *data, uint16_t timeout) {
-    return readBytes(regAddr, length, data);
+
+/** Find a chip-select strategy in the selector table, adding it if it is not.
+ * Strategies in use are never replaced, so new ones are refused once the
+ * table is full.
+ * @param select Strategy to look for
+ * @return Index of the strategy (SPIDEV_NO_SELECTOR = table full)
+ */
+uint8_t SPIdev::addSelector(SPIdevSelect *select) {
+    for (uint8_t i = 0; i < selectorCount; i++) {
+        if (selectors[i] == select) return i;
+    }
+    if (selectorCount >= SPIDEV_MAX_SELECTORS) return SPIDEV_NO_SELECTOR;
+    selectors[selectorCount] = select;
+    return selectorCount++;
 }
-int8_t SPIdev::readWords(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint16_t *data, uint16_t timeout) {
-    return readWords(regAddr, length, data);
+
+/** Start a transaction with the device: apply its settings and select it.
+ * @param regAddr Register address sent first, with the READ bit for reads
+ * @param length Number of data bytes transferred after the address
+ */
+void SPIdev::select(uint8_t regAddr, uint16_t length) {
+    if (session != this) SPI.beginTransaction(profiles()[profile]);
+
+    // the access is only described to the trace and the bus statistics
+    #ifndef SPIDEV_TRACE
+        (void) regAddr;
+    #endif
+    #if defined(SPIDEV_TRACE) || defined(SPIDEV_BUS_STATS)
+        uint32_t now = micros();
+    #else
+        (void) length;
+    #endif
+
+    #ifdef SPIDEV_TRACE
+        SPIdevTraceRecord &r = traceRecords[traceHead];
+        r.start = now;
+        r.slave = slave;
+        r.selector = selector;
+        r.regAddr = regAddr;
+        r.length = length;
+    #endif
+
+    #ifdef SPIDEV_BUS_STATS
+        if (bus.transactions > 0) {
+            // idle gap histogram, bucket n counts gaps of 2^n to 2^(n+1)-1 us
+            uint32_t gap = now - busEnd;
+            uint8_t bucket = 0;
+            while (gap > 1 && bucket < SPIDEV_IDLE_GAP_BUCKETS - 1) {
+                gap >>= 1;
+                bucket++;
+            }
+            if (bus.idleGaps[bucket] < 0xFFFF) bus.idleGaps[bucket]++;
+        }
+        bus.transactions++;
+        bus.bytes += (uint32_t) length + 1;
+        busStart = now;
+    #endif
+
+    #ifdef SPIDEV_FAULT_INJECTION
+        activeFaults = 0;
+        if (injectFault(faults.stuckHighRate)) { activeFaults |= SPIDEV_FAULT_STUCK_HIGH; faults.stuckHighs++; }
+        if (injectFault(faults.delayRate)) { activeFaults |= SPIDEV_FAULT_DELAY; faults.delays++; }
+        if (injectFault(faults.dropCSRate)) { activeFaults |= SPIDEV_FAULT_DROP_CS; faults.droppedCS++; return; }
+    #endif
+
+    csLow();
 }
 
-bool SPIdev::writeBit(uint8_t devAddr, uint8_t regAddr, uint8_t bitNum, uint8_t data) {
-    return writeBit(regAddr, bitNum, data);
+/** End a transaction with the device: de-select it and release the bus.
+ */
+void SPIdev::deselect() {
+    csHigh();
+
+    #ifdef SPIDEV_FAULT_INJECTION
+        if (activeFaults & SPIDEV_FAULT_DELAY) delayMicroseconds(faults.delayMicros);
+    #endif
+
+    #if defined(SPIDEV_TRACE) || defined(SPIDEV_BUS_STATS)
+        uint32_t now = micros();
+    #endif
+
+    #ifdef SPIDEV_BUS_STATS
+        busEnd = now;
+        bus.busyMicros += now - busStart;
+    #endif
+
+    #ifdef SPIDEV_TRACE
+        SPIdevTraceRecord &r = traceRecords[traceHead];
+        r.duration = now - r.start;
+        traceHead = (traceHead + 1) % SPIDEV_TRACE_LENGTH;
+        if (traceCount < SPIDEV_TRACE_LENGTH) traceCount++;
+    #endif
+
+    if (session != this) SPI.endTransaction();
 }
-bool SPIdev::writeBitW(uint8_t devAddr, uint8_t regAddr, uint8_t bitNum, uint16_t data) {
-    return writeBitW(regAddr, bitNum, data);
+
+/** Open a bus session with the device: until endSession(), its accesses all
+ * run in a single SPI transaction, only the chip select is toggled between
+ * them. No other device may be accessed during the session.
+ */
+void SPIdev::beginSession() {
+    if (!ready) return;
+    SPI.beginTransaction(profiles()[profile]);
+    session = this;
 }
-bool SPIdev::writeBits(uint8_t devAddr, uint8_t regAddr, uint8_t bitStart, uint8_t length, uint8_t data) {
-    return writeBits(regAddr, bitStart, length, data);
+
+/** Close the bus session opened by beginSession().
+ */
+void SPIdev::endSession() {
+    if (session != this) return;
+    session = NULL;
+    SPI.endTransaction();
 }
-bool SPIdev::writeBitsW(uint8_t devAddr, uint8_t regAddr, uint8_t bitStart, uint8_t length, uint16_t data) {
-    return writeBitsW(regAddr, bitStart, length, data);
+
+/** Exchange a single byte with the selected device.
+ * @param data Byte to send
+ * @return Byte received
+ */
+uint8_t SPIdev::transfer(uint8_t data) {
+    #ifdef SPIDEV_SOFT_LSBFIRST
+        if (dataOrder == LSBFIRST) {
+            data = reverseBits(SPI.transfer(reverseBits(data)));
+        } else
+    #endif
+    data = SPI.transfer(data);
+    #ifdef SPIDEV_FAULT_INJECTION
+        data = corrupt(data);
+    #endif
+    return data;
 }
-bool SPIdev::writeByte(uint8_t devAddr, uint8_t regAddr, uint8_t data) {
-    return writeByte(regAddr, data);
+
+/** Exchange a buffer with the selected device in a single burst.
+ * The received bytes overwrite the sent ones.
+ * @param data Buffer to send and to store received data in
+ * @param length Number of bytes to exchange
+ */
+void SPIdev::transfer(uint8_t *data, size_t length) {
+    #ifdef SPIDEV_SOFT_LSBFIRST
+        if (dataOrder == LSBFIRST) {
+            reverseBits(data, length);
+            SPI.transfer(data, length);
+            reverseBits(data, length);
+        } else
+    #endif
+    SPI.transfer(data, length);
+    #ifdef SPIDEV_FAULT_INJECTION
+        for (size_t i = 0; i < length; i++) {
+            data[i] = corrupt(data[i]);
+        }
+    #endif
 }
-bool SPIdev::writeWord(uint8_t devAddr, uint8_t regAddr, uint16_t data) {
-    return writeWord(regAddr, data);
+
+#ifdef SPIDEV_FAULT_INJECTION
+/** Fault profile applied to every transfer, all rates default to 0 (no faults).
+ */
+SPIdevFaults SPIdev::faults = {};
+uint8_t SPIdev::activeFaults = 0;
+
+/** Draw a fault with the given probability.
+ * Uses a xorshift generator, cheaper than random() so the injection itself
+ * barely shows up in the measured throughput.
+ * @param rate Probability in 1/65536 units
+ * @return True if the fault must be injected
+ */
+bool SPIdev::injectFault(uint16_t rate) {
+    static uint16_t state = 0xACE1;
+    if (rate == 0) return false;
+    state ^= state << 7;
+    state ^= state >> 9;
+    state ^= state << 8;
+    return state < rate;
+}
+
+/** Apply the active faults to a received byte.
+ * @param data Byte received from the device
+ * @return Byte as seen through the faulty bus
+ */
+uint8_t SPIdev::corrupt(uint8_t data) {
+    // a deselected device leaves MISO floating, pulled high on most boards
+    if (activeFaults & (SPIDEV_FAULT_STUCK_HIGH | SPIDEV_FAULT_DROP_CS)) return 0xFF;
+    if (injectFault(faults.bitFlipRate)) {
+        faults.bitFlips++;
+        data ^= 1 << (micros() & 0x07);
+    }
+    return data;
 }
-bool SPIdev::writeBytes(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8_t *data) {
-    return writeBytes(regAddr, length, data);
+#endif
+
+#ifdef SPIDEV_TRACE
+/** Last SPIDEV_TRACE_LENGTH transactions of every device, oldest first from
+ * traceHead - traceCount.
+ */
+SPIdevTraceRecord SPIdev::traceRecords[SPIDEV_TRACE_LENGTH];
+uint8_t SPIdev::traceHead = 0;
+uint8_t SPIdev::traceCount = 0;
+
+/** Write the recorded transactions as Chrome trace-event JSON.
+ * Open the output in chrome://tracing or https://ui.perfetto.dev: every
+ * device (slave pin, or strategy and address) is a track, every transaction
+ * a slice named after its register, so bus occupancy and the gaps between
+ * transactions show up at a glance. The trace is cleared once written.
+ * @param out Where to write the JSON, e.g. Serial
+ */
+void SPIdev::printTrace(Print &out) {
+    out.print("{\"traceEvents\":[{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":0,\"args\":{\"name\":\"SPI bus\"}}");
+    noInterrupts();
+    uint8_t count = traceCount;
+    uint8_t index = (traceHead + SPIDEV_TRACE_LENGTH - count) % SPIDEV_TRACE_LENGTH;
+    traceCount = 0;
+    interrupts();
+
+    // device tracks already named, the names of any further track are
+    // simply written again
+    uint16_t named[SPIDEV_TRACE_NAMED_TRACKS];
+    uint8_t namedCount = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        noInterrupts();
+        SPIdevTraceRecord r = traceRecords[index];
+        interrupts();
+        index = (index + 1) % SPIDEV_TRACE_LENGTH;
+
+        // pin devices keep their pin as track id, strategy devices get theirs
+        // above 255
+        uint16_t track = ((uint16_t) r.selector << 8) | r.slave;
+        uint8_t t = 0;
+        while (t < namedCount && named[t] != track) t++;
+
+        out.print(",");
+        if (t == namedCount) {
+            if (namedCount < SPIDEV_TRACE_NAMED_TRACKS) named[namedCount++] = track;
+            out.print("{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":0,\"tid\":");
+            out.print(track);
+            if (r.selector) {
+                out.print(",\"args\":{\"name\":\"SPIdev select ");
+                out.print(r.selector - 1);
+                out.print(" address ");
+            } else {
+                out.print(",\"args\":{\"name\":\"SPIdev pin ");
+            }
+            out.print(r.slave);
+            out.print("\"}},");
+        }
+        out.print("{\"ph\":\"X\",\"cat\":\"spi\",\"name\":\"");
+        out.print((r.regAddr & READ) ? "read 0x" : "write 0x");
+        out.print(r.regAddr & ~READ, HEX);
+        out.print("\",\"pid\":0,\"tid\":");
+        out.print(track);
+        out.print(",\"ts\":");
+        out.print(r.start);
+        out.print(",\"dur\":");
+        out.print(r.duration);
+        out.print(",\"args\":{\"bytes\":");
+        out.print(r.length);
+        out.print("}}");
+    }
+    out.println("]}");
 }
-bool SPIdev::writeWords(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint16_t *data) {
-    return writeWords(regAddr, length, data);
+#endif
+
+#ifdef SPIDEV_BUS_STATS
+/** Bus statistics accumulated since the last reset.
+ */
+SPIdevBusStats SPIdev::bus = {};
+uint32_t SPIdev::busSince = 0;
+uint32_t SPIdev::busStart = 0;
+uint32_t SPIdev::busEnd = 0;
+
+/** Take a consistent snapshot of the bus statistics.
+ * Only copies counters (with interrupts briefly disabled), it never touches
+ * the bus. Utilization is busyMicros / elapsedMicros, throughput bytes or
+ * transactions / elapsedMicros.
+ * @param stats Where to copy the statistics
+ * @param reset Start a new measurement window after the copy
+ */
+void SPIdev::busStats(SPIdevBusStats &stats, bool reset) {
+    noInterrupts();
+    uint32_t now = micros();
+    stats = bus;
+    stats.elapsedMicros = now - busSince;
+    if (reset) {
+        memset(&bus, 0, sizeof(bus));
+        busSince = now;
+    }
+    interrupts();
 }
+#endif
+
+/** Number of profiles in use in the profile table.
+ */
+uint8_t SPIdev::profileCount = 0;
+
+/** Device holding the bus session, if any.
+ */
+SPIdev *SPIdev::session = NULL;
+
+/** Buffer writes and oversampled reads go through, shared by all devices:
+ * only one transaction uses it at a time.
+ */
+uint8_t SPIdev::transferBuffer[SPIDEV_BUFFER_LENGTH];
+
+/** Chip-select strategies shared by all devices.
+ */
+SPIdevSelect *SPIdev::selectors[SPIDEV_MAX_SELECTORS];
+uint8_t SPIdev::selectorCount = 0;
+
+/** Default timeout value for read operations.
+ * Set this to 0 to disable timeout detection.
+ */
+//uint16_t SPIdev::readTimeout = SPIDEV_DEFAULT_READ_TIMEOUT;
+uint16_t SPIdev::readTimeout = 0;
+
+#ifdef SPIDEV_CRC
+/** Maximum number of retries of a CRC-protected read.
+ */
+uint8_t SPIdev::crcRetries = SPIDEV_DEFAULT_CRC_RETRIES;
+#endif
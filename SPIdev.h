@@ -41,70 +41,316 @@ SOFTWARE.
 // -----------------------------------------------------------------------------
 //#define SPIDEV_SERIAL_DEBUG
 
+// -----------------------------------------------------------------------------
+// Software LSB-first fallback constant (uncomment to enable)
+// For SPI backends without native LSB-first support: build the SPISettings with
+// MSBFIRST and pass LSBFIRST as bitOrder, the bytes are then bit-reversed in
+// software before and after each burst
+// -----------------------------------------------------------------------------
+//#define SPIDEV_SOFT_LSBFIRST
+
+// -----------------------------------------------------------------------------
+// Fault injection constant (uncomment to enable)
+// Corrupts transfers at the rates set in "SPIdev::faults" to measure retries,
+// timeouts and CRC checks on a noisy bus. Never enable it in production builds
+// -----------------------------------------------------------------------------
+//#define SPIDEV_FAULT_INJECTION
+
+// -----------------------------------------------------------------------------
+// Transaction trace constant (uncomment to enable)
+// Records device, register, length and timestamps of the last
+// SPIDEV_TRACE_LENGTH transactions, "SPIdev::printTrace(Serial);" dumps them
+// -----------------------------------------------------------------------------
+//#define SPIDEV_TRACE
+#define SPIDEV_TRACE_LENGTH             32
+// Device tracks printTrace keeps track of, a further device gets its track
+// name written again with each of its transactions
+#define SPIDEV_TRACE_NAMED_TRACKS       16
+
+// -----------------------------------------------------------------------------
+// Bus statistics constant (uncomment to enable)
+// Counts busy time, bytes, transactions and idle gaps of the SPI bus, read
+// them at runtime with "SPIdev::busStats(stats);"
+// -----------------------------------------------------------------------------
+//#define SPIDEV_BUS_STATS
+#define SPIDEV_IDLE_GAP_BUCKETS         16
+
+// -----------------------------------------------------------------------------
+// CRC-protected reads constant (uncomment to enable)
+// Adds readBytesCRC and the per-device CRC counters
+// -----------------------------------------------------------------------------
+//#define SPIDEV_CRC
+
 #include "Arduino.h"
 #include <SPI.h> 
+#include "SPIdevSelect.h"
 
 // Arduino SPI implementation doesn't support transfer timeout at least 
 // 1000ms default read timeout (modify with "SPIdev::readTimeout = [ms];")
 //#define SPIDEV_DEFAULT_READ_TIMEOUT     1000
 
+// Maximum number of times a CRC-protected read is re-issued after a mismatch
+// before giving up (modify with "SPIdev::crcRetries = [n];")
+#define SPIDEV_DEFAULT_CRC_RETRIES      2
+
+// Maximum number of distinct SPISettings shared by all devices, devices with
+// equal settings share a profile (at most 16)
+#define SPIDEV_MAX_PROFILES             8
+#if SPIDEV_MAX_PROFILES > 16
+    #error "SPIDEV_MAX_PROFILES must fit the 4-bit profile index"
+#endif
+#define SPIDEV_NO_PROFILE               0xFF
+
+// Maximum number of chip-select strategies shared by all devices (at most 7)
+#define SPIDEV_MAX_SELECTORS            4
+#if SPIDEV_MAX_SELECTORS > 7
+    #error "SPIDEV_MAX_SELECTORS must fit the 3-bit selector index"
+#endif
+#define SPIDEV_NO_SELECTOR              0xFF
+
+// Maximum number of 16-bit channels averaged by readWordsOversampled
+#define SPIDEV_OVERSAMPLE_MAX_CHANNELS  8
+
+// Size of the buffer shared by all devices that writes are sent through in
+// bursts, longer writes are split into several bursts in the same transaction
+#define SPIDEV_BUFFER_LENGTH            32
+
+#if SPIDEV_BUFFER_LENGTH < 2 * SPIDEV_OVERSAMPLE_MAX_CHANNELS
+#error "SPIDEV_BUFFER_LENGTH must hold a readWordsOversampled sample"
+#endif
+
+#ifdef SPIDEV_FAULT_INJECTION
+// Fault profile, rates are probabilities in 1/65536 units (0 = never)
+struct SPIdevFaults {
+    uint16_t bitFlipRate;       // per received byte: one random bit flipped
+    uint16_t stuckHighRate;     // per transaction: MISO stuck high (0xFF)
+    uint16_t dropCSRate;        // per transaction: chip select never asserted
+    uint16_t delayRate;         // per transaction: completion delayed
+    uint16_t delayMicros;       // length of a delayed completion
+
+    // number of faults injected so far
+    uint16_t bitFlips;
+    uint16_t stuckHighs;
+    uint16_t droppedCS;
+    uint16_t delays;
+};
+
+#define SPIDEV_FAULT_STUCK_HIGH     0x01
+#define SPIDEV_FAULT_DROP_CS        0x02
+#define SPIDEV_FAULT_DELAY          0x04
+#endif
+
+#ifdef SPIDEV_TRACE
+struct SPIdevTraceRecord {
+    uint32_t start;             // micros() when the transaction began
+    uint16_t duration;          // microseconds until it ended
+    uint16_t length;            // data bytes after the register address
+    uint8_t slave;              // slave pin of the device, or its address on the strategy
+    uint8_t selector;           // chip-select strategy + 1 (0 = slave pin)
+    uint8_t regAddr;            // register address, with the READ bit for reads
+};
+#endif
+
+#ifdef SPIDEV_BUS_STATS
+struct SPIdevBusStats {
+    uint32_t elapsedMicros;     // length of the measurement window
+    uint32_t busyMicros;        // time with a device selected
+    uint32_t bytes;             // bytes transferred, register addresses included
+    uint32_t transactions;
+    uint16_t idleGaps[SPIDEV_IDLE_GAP_BUCKETS]; // gaps of 2^n to 2^(n+1)-1 us
+};
+#endif
+
 #define READ 0B10000000
 //#define WRITE 0B00000000 // Write is implicit
 
+/*
+    Each device only keeps a compact descriptor: its slave pin, the index of its
+    settings in a table shared by all devices, and its data order packed in the
+    same byte, and its ready flags in one more byte (3 bytes without
+    SPIDEV_CRC). On AVR the slave pin is also kept as a port and bit mask (5
+    bytes), so the chip select is driven straight through the port register.
+    A device whose settings or strategy find no room left in their table, or
+    whose address its strategy does not accept, is not ready: it never
+    selects itself, and its reads and writes fail.
+    Devices behind a decoder, shift register or shared port are built on a
+    SPIdevSelect strategy instead, and slave is then their address on it; the
+    strategy is registered in a shared table too, and the direct slave pin
+    remains the fast path.
+*/
 class SPIdev {
     public:
         uint8_t slave;
-        uint8_t dataOrder;
-        SPISettings settings;
+        uint8_t dataOrder : 1;  // MSBFIRST or LSBFIRST
+        uint8_t profile : 4;    // index of the device settings in the profile table
+        uint8_t selector : 3;   // chip-select strategy + 1 (0 = slave pin)
+        bool ready : 1;         // false if the device could not be registered
+        bool selectable : 1;    // false if its strategy refused it (ready stays false)
+
+        #ifdef SPIDEV_CRC
+            // CRC-protected reads
+            uint8_t crcSeed;        // initial CRC value
+            uint16_t crcErrors;     // number of frames received with a bad CRC
+            uint16_t crcFailures;   // number of reads given up after all retries
+        #endif
 
         SPIdev(int8_t slavePin, SPISettings settings, uint8_t bitOrder);
+        SPIdev(SPIdevSelect &select, uint8_t address, SPISettings settings, uint8_t bitOrder);
 
-        void setSPISettings(SPISettings settings);
+        bool setSPISettings(SPISettings settings);
+        SPISettings getSPISettings() { return profiles()[profile]; }
 
         int8_t readBit(uint8_t regAddr, uint8_t bitNum, uint8_t *data);
         int8_t readBitW(uint8_t regAddr, uint8_t bitNum, uint16_t *data);
         int8_t readBits(uint8_t regAddr, uint8_t bitStart, uint8_t length, uint8_t *data);
         int8_t readBitsW(uint8_t regAddr, uint8_t bitStart, uint8_t length, uint16_t *data);
-        int8_t readByte(uint8_t regAddr, uint8_t *data);
-        int8_t readWord(uint8_t regAddr, uint16_t *data);
+        int8_t readByte(uint8_t regAddr, uint8_t *data) { return readBytes(regAddr, 1, data); }
+        int8_t readWord(uint8_t regAddr, uint16_t *data) { return readWords(regAddr, 1, data); }
         int8_t readBytes(uint8_t regAddr, uint8_t length, uint8_t *data);
         int8_t readWords(uint8_t regAddr, uint8_t length, uint16_t *data);
+        #ifdef SPIDEV_CRC
+            int8_t readBytesCRC(uint8_t regAddr, uint8_t length, uint8_t *data);
+        #endif
+        int8_t readWordsOversampled(uint8_t regAddr, uint8_t length, uint8_t samples, int16_t *average, int16_t *minimum = NULL, int16_t *maximum = NULL);
+        bool transferFrames(uint8_t *data, uint8_t frameSize, uint8_t frames, uint16_t gapMicros = 0);
+
+        void beginSession();
+        void endSession();
 
         bool writeBit(uint8_t regAddr, uint8_t bitNum, uint8_t data);
         bool writeBitW(uint8_t regAddr, uint8_t bitNum, uint16_t data);
         bool writeBits(uint8_t regAddr, uint8_t bitStart, uint8_t length, uint8_t data);
         bool writeBitsW(uint8_t regAddr, uint8_t bitStart, uint8_t length, uint16_t data);
-        bool writeByte(uint8_t regAddr, uint8_t data);
-        bool writeWord(uint8_t regAddr, uint16_t data);
+        bool writeByte(uint8_t regAddr, uint8_t data) { return writeBytes(regAddr, 1, &data); }
+        bool writeWord(uint8_t regAddr, uint16_t data) { return writeWords(regAddr, 1, &data); }
         bool writeBytes(uint8_t regAddr, uint8_t length, uint8_t *data);
         bool writeWords(uint8_t regAddr, uint8_t length, uint16_t *data);
 
+        static uint8_t reverseBits(uint8_t data);
+        static void reverseBits(uint8_t *data, size_t length);
+
+        static uint8_t profileCount;
+
+        static uint8_t crc8(const uint8_t *data, size_t length, uint8_t crc = 0x00);
+        #ifdef SPIDEV_CRC
+            static uint8_t crcRetries;
+        #endif
+
+        #ifdef SPIDEV_FAULT_INJECTION
+            static SPIdevFaults faults;
+        #endif
+
+        #ifdef SPIDEV_TRACE
+            static void printTrace(Print &out);
+        #endif
+
+        #ifdef SPIDEV_BUS_STATS
+            static void busStats(SPIdevBusStats &stats, bool reset = false);
+        #endif
+
         /*
             For compatibility with I2C interface
             We use the similar interface but ignoring the unnecessary variables
             with the intention of having compatibility with sensors in I2Cdev library 
             that have I2C and SPI interface
             https://github.com/jrowberg/i2cdevlib/blob/master/Arduino/I2Cdev/I2Cdev.h
+            The stubs are inline, so they cost nothing unless they are called.
         */
         static uint16_t readTimeout;
         
-        int8_t readBit(uint8_t devAddr, uint8_t regAddr, uint8_t bitNum, uint8_t *data, uint16_t timeout=SPIdev::readTimeout);
-        int8_t readBitW(uint8_t devAddr, uint8_t regAddr, uint8_t bitNum, uint16_t *data, uint16_t timeout=SPIdev::readTimeout);
-        int8_t readBits(uint8_t devAddr, uint8_t regAddr, uint8_t bitStart, uint8_t length, uint8_t *data, uint16_t timeout=SPIdev::readTimeout);
-        int8_t readBitsW(uint8_t devAddr, uint8_t regAddr, uint8_t bitStart, uint8_t length, uint16_t *data, uint16_t timeout=SPIdev::readTimeout);
-        int8_t readByte(uint8_t devAddr, uint8_t regAddr, uint8_t *data, uint16_t timeout=SPIdev::readTimeout);
-        int8_t readWord(uint8_t devAddr, uint8_t regAddr, uint16_t *data, uint16_t timeout=SPIdev::readTimeout);
-        int8_t readBytes(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8_t *data, uint16_t timeout=SPIdev::readTimeout);
-        int8_t readWords(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint16_t *data, uint16_t timeout=SPIdev::readTimeout);
-
-        bool writeBit(uint8_t devAddr, uint8_t regAddr, uint8_t bitNum, uint8_t data);
-        bool writeBitW(uint8_t devAddr, uint8_t regAddr, uint8_t bitNum, uint16_t data);
-        bool writeBits(uint8_t devAddr, uint8_t regAddr, uint8_t bitStart, uint8_t length, uint8_t data);
-        bool writeBitsW(uint8_t devAddr, uint8_t regAddr, uint8_t bitStart, uint8_t length, uint16_t data);
-        bool writeByte(uint8_t devAddr, uint8_t regAddr, uint8_t data);
-        bool writeWord(uint8_t devAddr, uint8_t regAddr, uint16_t data);
-        bool writeBytes(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8_t *data);
-        bool writeWords(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint16_t *data);
+        int8_t readBit(uint8_t /*devAddr*/, uint8_t regAddr, uint8_t bitNum, uint8_t *data, uint16_t /*timeout*/=SPIdev::readTimeout) { return readBit(regAddr, bitNum, data); }
+        int8_t readBitW(uint8_t /*devAddr*/, uint8_t regAddr, uint8_t bitNum, uint16_t *data, uint16_t /*timeout*/=SPIdev::readTimeout) { return readBitW(regAddr, bitNum, data); }
+        int8_t readBits(uint8_t /*devAddr*/, uint8_t regAddr, uint8_t bitStart, uint8_t length, uint8_t *data, uint16_t /*timeout*/=SPIdev::readTimeout) { return readBits(regAddr, bitStart, length, data); }
+        int8_t readBitsW(uint8_t /*devAddr*/, uint8_t regAddr, uint8_t bitStart, uint8_t length, uint16_t *data, uint16_t /*timeout*/=SPIdev::readTimeout) { return readBitsW(regAddr, bitStart, length, data); }
+        int8_t readByte(uint8_t /*devAddr*/, uint8_t regAddr, uint8_t *data, uint16_t /*timeout*/=SPIdev::readTimeout) { return readByte(regAddr, data); }
+        int8_t readWord(uint8_t /*devAddr*/, uint8_t regAddr, uint16_t *data, uint16_t /*timeout*/=SPIdev::readTimeout) { return readWord(regAddr, data); }
+        int8_t readBytes(uint8_t /*devAddr*/, uint8_t regAddr, uint8_t length, uint8_t *data, uint16_t /*timeout*/=SPIdev::readTimeout) { return readBytes(regAddr, length, data); }
+        int8_t readWords(uint8_t /*devAddr*/, uint8_t regAddr, uint8_t length, uint16_t *data, uint16_t /*timeout*/=SPIdev::readTimeout) { return readWords(regAddr, length, data); }
+
+        bool writeBit(uint8_t /*devAddr*/, uint8_t regAddr, uint8_t bitNum, uint8_t data) { return writeBit(regAddr, bitNum, data); }
+        bool writeBitW(uint8_t /*devAddr*/, uint8_t regAddr, uint8_t bitNum, uint16_t data) { return writeBitW(regAddr, bitNum, data); }
+        bool writeBits(uint8_t /*devAddr*/, uint8_t regAddr, uint8_t bitStart, uint8_t length, uint8_t data) { return writeBits(regAddr, bitStart, length, data); }
+        bool writeBitsW(uint8_t /*devAddr*/, uint8_t regAddr, uint8_t bitStart, uint8_t length, uint16_t data) { return writeBitsW(regAddr, bitStart, length, data); }
+        bool writeByte(uint8_t /*devAddr*/, uint8_t regAddr, uint8_t data) { return writeByte(regAddr, data); }
+        bool writeWord(uint8_t /*devAddr*/, uint8_t regAddr, uint16_t data) { return writeWord(regAddr, data); }
+        bool writeBytes(uint8_t /*devAddr*/, uint8_t regAddr, uint8_t length, uint8_t *data) { return writeBytes(regAddr, length, data); }
+        bool writeWords(uint8_t /*devAddr*/, uint8_t regAddr, uint8_t length, uint16_t *data) { return writeWords(regAddr, length, data); }
+
+    private:
+        #ifdef __AVR__
+            uint8_t csPort;     // port of the slave pin
+            uint8_t csMask;     // bit of the slave pin in its port
+        #endif
+
+        static SPISettings *profiles();
+        static uint8_t addProfile(const SPISettings &settings);
+
+        static SPIdev *session;
+        static uint8_t transferBuffer[SPIDEV_BUFFER_LENGTH];
+
+        static SPIdevSelect *selectors[SPIDEV_MAX_SELECTORS];
+        static uint8_t selectorCount;
+        static uint8_t addSelector(SPIdevSelect *select);
+
+        void select(uint8_t regAddr, uint16_t length);
+        void deselect();
+        void csLow();
+        void csHigh();
+        uint8_t transfer(uint8_t data);
+        void transfer(uint8_t *data, size_t length);
+
+        #ifdef SPIDEV_FAULT_INJECTION
+            static uint8_t activeFaults;
+            static bool injectFault(uint16_t rate);
+            static uint8_t corrupt(uint8_t data);
+        #endif
+
+        #ifdef SPIDEV_TRACE
+            static SPIdevTraceRecord traceRecords[SPIDEV_TRACE_LENGTH];
+            static uint8_t traceHead;
+            static uint8_t traceCount;
+        #endif
+
+        #ifdef SPIDEV_BUS_STATS
+            static SPIdevBusStats bus;
+            static uint32_t busSince;
+            static uint32_t busStart;
+            static uint32_t busEnd;
+        #endif
 };
 
+// Select the chip
+inline void SPIdev::csLow() {
+    if (selector) {
+        selectors[selector - 1]->select(slave);
+        return;
+    }
+    #ifdef __AVR__
+        volatile uint8_t *out = portOutputRegister(csPort);
+        uint8_t oldSREG = SREG;
+        cli();
+        *out &= ~csMask;
+        SREG = oldSREG;
+    #else
+        digitalWrite(slave, LOW);
+    #endif
+}
+
+// De-select the chip
+inline void SPIdev::csHigh() {
+    if (selector) {
+        selectors[selector - 1]->deselect(slave);
+        return;
+    }
+    #ifdef __AVR__
+        volatile uint8_t *out = portOutputRegister(csPort);
+        uint8_t oldSREG = SREG;
+        cli();
+        *out |= csMask;
+        SREG = oldSREG;
+    #else
+        digitalWrite(slave, HIGH);
+    #endif
+}
+
 #endif
@@ -0,0 +1,231 @@
+// SPIdev library collection - Sample processing stages
+// Integer filters applied to blocks of samples read through SPIdev
+// 2020-05-03 by Rafael Carbonell <racarla96@gmail.com>
+//
+// Changelog:
+//      2020-05-?? - initial release
+
+/* ============================================
+SPIdev device library code 
+
+MIT License
+
+Copyright (c) 2020 racarla96
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================
+*/
+
+#include "SPIdevDSP.h"
+
+// Keeps the compiler from reordering memory writes around a buffer swap
+#define SPIDEV_BARRIER()    __asm__ __volatile__ ("" ::: "memory")
+
+/** Convert raw readings (e.g. from SPIdev::readWords) to samples.
+ * In fixed point this is a plain reinterpretation of the two's complement
+ * reading as Q15, no arithmetic is involved.
+ * @param raw Raw 16-bit readings
+ * @param samples Buffer to store the samples in (may be raw itself in fixed point)
+ * @param count Number of readings
+ */
+void decodeSamples(const uint16_t *raw, spidev_sample_t *samples, uint8_t count) {
+    for (uint8_t i = 0; i < count; i++) {
+        #ifdef SPIDEV_FLOAT_SAMPLES
+            samples[i] = (int16_t) raw[i] * (1.0f / 32768.0f);
+        #else
+            samples[i] = (q15_t) raw[i];
+        #endif
+    }
+}
+
+/** Multiply samples by a gain, in place (saturating in fixed point).
+ * @param samples Samples to scale
+ * @param count Number of samples
+ * @param gain Gain to apply
+ */
+void scaleSamples(spidev_sample_t *samples, uint8_t count, spidev_sample_t gain) {
+    for (uint8_t i = 0; i < count; i++) {
+        #ifdef SPIDEV_FLOAT_SAMPLES
+            samples[i] *= gain;
+        #else
+            samples[i] = q15Mul(samples[i], gain);
+        #endif
+    }
+}
+
+/** Default constructor.
+ * @param alpha Smoothing factor in (0, 1], 1 lets the input through
+ */
+SPIdevLowPass::SPIdevLowPass(spidev_sample_t alpha) {
+    this->alpha = alpha;
+    reset();
+}
+
+/** Restart the filter from a given output value.
+ * @param value Initial output value
+ */
+void SPIdevLowPass::reset(spidev_sample_t value) {
+    output = value;
+    #ifndef SPIDEV_FLOAT_SAMPLES
+        residual = 0;
+    #endif
+}
+
+/** Filter samples in place.
+ * @param samples Samples to filter
+ * @param count Number of samples
+ */
+void SPIdevLowPass::process(spidev_sample_t *samples, uint8_t count) {
+    for (uint8_t i = 0; i < count; i++) {
+        #ifdef SPIDEV_FLOAT_SAMPLES
+            output += alpha * (samples[i] - output);
+        #else
+            // |x - y| <= 65535 and alpha <= 32767, the sum cannot overflow
+            int32_t acc = (int32_t) alpha * ((int32_t) samples[i] - output) + residual;
+            int32_t step = acc >> 15;
+            residual = acc - (step << 15);
+            output = q15Saturate((int32_t) output + step);
+        #endif
+        samples[i] = output;
+    }
+}
+
+/** Default constructor.
+ * @param channels Number of channels in each block (up to SPIDEV_DECIMATOR_MAX_CHANNELS)
+ * @param ratio Decimation ratio, one output sample every ratio input samples
+ * @param order Number of integrator and comb stages (up to SPIDEV_CIC_MAX_ORDER),
+ *        lowered if ratio^order would exceed SPIDEV_CIC_MAX_GAIN
+ */
+SPIdevDecimator::SPIdevDecimator(uint8_t channels, uint8_t ratio, uint8_t order) {
+    this->channels = min(channels, (uint8_t) SPIDEV_DECIMATOR_MAX_CHANNELS);
+    this->ratio = max(ratio, (uint8_t) 1);
+    this->order = constrain(order, (uint8_t) 1, (uint8_t) SPIDEV_CIC_MAX_ORDER);
+
+    // DC gain of the filter is ratio^order, lower the order until it fits the
+    // headroom of the integrators (a single stage always does)
+    while (true) {
+        gain = 1;
+        for (uint8_t i = 0; i < this->order; i++) gain *= this->ratio;
+        if (gain <= SPIDEV_CIC_MAX_GAIN || this->order == 1) break;
+        this->order--;
+    }
+    shift = 0;
+    while (((uint32_t) 1 << shift) < gain) shift++;
+    if (((uint32_t) 1 << shift) != gain) shift = 0xFF;
+
+    reset();
+}
+
+/** Clear the filter state, e.g. after a gap in the input stream.
+ */
+void SPIdevDecimator::reset() {
+    phase = 0;
+    memset(integrator, 0, sizeof(integrator));
+    memset(comb, 0, sizeof(comb));
+}
+
+/** Filter and decimate a block of samples.
+ * The output may be the input block itself: output samples are never written
+ * ahead of the input samples still to be read.
+ * @param block Input samples, block[channel][sample]
+ * @param count Number of samples per channel in the block
+ * @param output Buffers to store the decimated samples in, output[channel][sample]
+ * @return Number of samples per channel written to output
+ */
+uint8_t SPIdevDecimator::process(int16_t *const *block, uint8_t count, int16_t *const *output) {
+    uint8_t produced = 0;
+    uint8_t p = phase;
+
+    for (uint8_t c = 0; c < channels; c++) {
+        const int16_t *in = block[c];
+        int16_t *out = output[c];
+        uint32_t *acc = integrator[c];
+        uint32_t *delay = comb[c];
+        p = phase;
+        produced = 0;
+
+        for (uint8_t i = 0; i < count; i++) {
+            // integrators, at the input rate
+            uint32_t v = (uint32_t) (int32_t) in[i];
+            for (uint8_t s = 0; s < order; s++) {
+                acc[s] += v;
+                v = acc[s];
+            }
+            if (++p < ratio) continue;
+            p = 0;
+
+            // combs, at the output rate
+            for (uint8_t s = 0; s < order; s++) {
+                uint32_t prev = delay[s];
+                delay[s] = v;
+                v -= prev;
+            }
+            int32_t y = (int32_t) v;
+            out[produced++] = (int16_t) ((shift != 0xFF) ? (y >> shift) : (y / (int32_t) gain));
+        }
+    }
+
+    phase = p;
+    return produced;
+}
+
+/** Default constructor, starts with the identity calibration.
+ */
+SPIdevCalibration::SPIdevCalibration() {
+    memset(parameters, 0, sizeof(parameters));
+    for (uint8_t i = 0; i < 3; i++) {
+        parameters[0].matrix[i][i] = SPIDEV_CAL_ONE;
+    }
+    active = 0;
+}
+
+/** Replace the calibration parameters.
+ * The new set is written while the current one stays in use, then becomes
+ * active for the next block. At most one swap may happen per apply() call.
+ * @param matrix Scale and cross-axis matrix, Q3.12 coefficients
+ * @param bias Offset subtracted from each axis before the matrix
+ */
+void SPIdevCalibration::setParameters(const int16_t matrix[3][3], const int16_t bias[3]) {
+    uint8_t idle = active ^ 1;
+    memcpy(parameters[idle].matrix, matrix, sizeof(parameters[idle].matrix));
+    memcpy(parameters[idle].bias, bias, sizeof(parameters[idle].bias));
+    // the new set must be complete before an interrupt may pick it up
+    SPIDEV_BARRIER();
+    active = idle;
+}
+
+/** Calibrate a block of samples in place.
+ * @param x Samples of the first axis
+ * @param y Samples of the second axis
+ * @param z Samples of the third axis
+ * @param count Number of samples per axis in the block
+ */
+void SPIdevCalibration::apply(int16_t *x, int16_t *y, int16_t *z, uint8_t count) {
+    const Parameters &p = parameters[active];
+    const int32_t round = (int32_t) 1 << (SPIDEV_CAL_FRACTION_BITS - 1);
+
+    for (uint8_t i = 0; i < count; i++) {
+        int32_t u = q15Saturate((int32_t) x[i] - p.bias[0]);
+        int32_t v = q15Saturate((int32_t) y[i] - p.bias[1]);
+        int32_t w = q15Saturate((int32_t) z[i] - p.bias[2]);
+        x[i] = q15Saturate((p.matrix[0][0] * u + p.matrix[0][1] * v + p.matrix[0][2] * w + round) >> SPIDEV_CAL_FRACTION_BITS);
+        y[i] = q15Saturate((p.matrix[1][0] * u + p.matrix[1][1] * v + p.matrix[1][2] * w + round) >> SPIDEV_CAL_FRACTION_BITS);
+        z[i] = q15Saturate((p.matrix[2][0] * u + p.matrix[2][1] * v + p.matrix[2][2] * w + round) >> SPIDEV_CAL_FRACTION_BITS);
+    }
+}
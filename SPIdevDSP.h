@@ -0,0 +1,177 @@
+// SPIdev library collection - Sample processing stages header file
+// Integer filters applied to blocks of samples read through SPIdev
+// 2020-05-03 by Rafael Carbonell <racarla96@gmail.com>
+//
+// Changelog:
+//      2020-05-?? - initial release
+
+/* ============================================
+SPIdev device library code 
+
+MIT License
+
+Copyright (c) 2020 racarla96
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================
+*/
+
+#ifndef _SPIDEVDSP_H_
+#define _SPIDEVDSP_H_
+
+// -----------------------------------------------------------------------------
+// Float sample path constant (uncomment to enable)
+// By default decodeSamples, scaleSamples and SPIdevLowPass work on Q15 fixed
+// point samples with saturating arithmetic, which is much cheaper on MCUs
+// without an FPU (atmelavr, atmelmegaavr)
+// -----------------------------------------------------------------------------
+//#define SPIDEV_FLOAT_SAMPLES
+
+#include "Arduino.h"
+
+// Maximum number of channels and CIC order of a SPIdevDecimator
+#define SPIDEV_DECIMATOR_MAX_CHANNELS   4
+#define SPIDEV_CIC_MAX_ORDER            4
+// Largest DC gain ratio^order of a SPIdevDecimator: 16-bit samples times the
+// gain must fit the 32-bit integrators
+#define SPIDEV_CIC_MAX_GAIN             65536UL
+
+// Fractional bits of the SPIdevCalibration matrix coefficients (Q3.12)
+#define SPIDEV_CAL_FRACTION_BITS        12
+#define SPIDEV_CAL_ONE                  (1 << SPIDEV_CAL_FRACTION_BITS)
+
+// Q15 (1.15) and Q31 (1.31) fixed point: -1.0 <= value < 1.0
+typedef int16_t q15_t;
+typedef int32_t q31_t;
+
+#define Q15(x)  ((q15_t) ((x) >= 0.999969482421875 ? 32767 : (x) * 32768.0))
+
+/** Saturate a 32-bit value to the Q15 range.
+ */
+static inline q15_t q15Saturate(int32_t v) {
+    if (v > 32767) return 32767;
+    if (v < -32768) return -32768;
+    return (q15_t) v;
+}
+
+/** Saturating Q15 addition.
+ */
+static inline q15_t q15Add(q15_t a, q15_t b) {
+    return q15Saturate((int32_t) a + b);
+}
+
+/** Saturating Q15 subtraction.
+ */
+static inline q15_t q15Sub(q15_t a, q15_t b) {
+    return q15Saturate((int32_t) a - b);
+}
+
+/** Rounded, saturating Q15 multiplication (-1.0 * -1.0 gives 0.99997).
+ */
+static inline q15_t q15Mul(q15_t a, q15_t b) {
+    return q15Saturate(((int32_t) a * b + 0x4000) >> 15);
+}
+
+// Sample type of the processing path, a full scale reading is 1.0
+// (write constants as SPIDEV_SAMPLE(0.25) to build with either path)
+#ifdef SPIDEV_FLOAT_SAMPLES
+typedef float spidev_sample_t;
+#define SPIDEV_SAMPLE(x)    ((float) (x))
+#else
+typedef q15_t spidev_sample_t;
+#define SPIDEV_SAMPLE(x)    Q15(x)
+#endif
+
+void decodeSamples(const uint16_t *raw, spidev_sample_t *samples, uint8_t count);
+void scaleSamples(spidev_sample_t *samples, uint8_t count, spidev_sample_t gain);
+
+/*
+    First order low-pass filter: y += alpha * (x - y), alpha in (0, 1].
+    In fixed point the truncated part of each update is carried over to the
+    next one, so small alphas do not leave a dead band around the input.
+*/
+class SPIdevLowPass {
+    public:
+        SPIdevLowPass(spidev_sample_t alpha);
+
+        void reset(spidev_sample_t value = 0);
+        void process(spidev_sample_t *samples, uint8_t count);
+
+    private:
+        spidev_sample_t alpha;
+        spidev_sample_t output;
+        #ifndef SPIDEV_FLOAT_SAMPLES
+            int32_t residual;
+        #endif
+};
+
+/*
+    CIC decimation filter for signed 16-bit samples.
+    Blocks are passed structure-of-arrays: block[channel][sample]. The output
+    is normalised by the DC gain ratio^order, so it keeps the input scale. The
+    integrators wrap around modulo 2^32, which is exact as long as
+    ratio^order <= SPIDEV_CIC_MAX_GAIN (e.g. ratio 40 with order 3); the
+    constructor lowers the order of filters that would exceed it.
+*/
+class SPIdevDecimator {
+    public:
+        SPIdevDecimator(uint8_t channels, uint8_t ratio, uint8_t order = 3);
+
+        void reset();
+        uint8_t process(int16_t *const *block, uint8_t count, int16_t *const *output);
+
+    private:
+        uint8_t channels;
+        uint8_t ratio;
+        uint8_t order;
+        uint8_t phase;
+        uint8_t shift;          // log2 of the gain when it is a power of two
+        uint32_t gain;
+        uint32_t integrator[SPIDEV_DECIMATOR_MAX_CHANNELS][SPIDEV_CIC_MAX_ORDER];
+        uint32_t comb[SPIDEV_DECIMATOR_MAX_CHANNELS][SPIDEV_CIC_MAX_ORDER];
+};
+
+/*
+    Calibration of 3-axis signed 16-bit samples: out = matrix * (in - bias).
+    The matrix holds scale factors on its diagonal and cross-axis terms off it,
+    as Q3.12 fixed-point coefficients (SPIDEV_CAL_ONE = 1.0), so no FPU is
+    needed. Results saturate to the int16_t range; the absolute values of each
+    matrix row must add up to less than 16.0 for the products not to overflow.
+    Parameters are double-buffered: setParameters fills the idle set and then
+    switches to it, so it may be called while blocks are being calibrated
+    (e.g. from an interrupt); each block uses a single, complete set.
+*/
+class SPIdevCalibration {
+    public:
+        SPIdevCalibration();
+
+        void setParameters(const int16_t matrix[3][3], const int16_t bias[3]);
+        void apply(int16_t *x, int16_t *y, int16_t *z, uint8_t count);
+
+    private:
+        struct Parameters {
+            int16_t matrix[3][3];
+            int16_t bias[3];
+        };
+
+        Parameters parameters[2];
+        volatile uint8_t active;
+};
+
+#endif
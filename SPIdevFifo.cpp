@@ -0,0 +1,433 @@
+// SPIdev library collection - Sensor FIFO drain engine
+// Reads buffered samples out of sensor FIFOs and tracks lost samples
+// 2020-05-03 by Rafael Carbonell <racarla96@gmail.com>
+//
+// Changelog:
+//      2020-05-?? - initial release
+
+/* ============================================
+SPIdev device library code 
+
+MIT License
+
+Copyright (c) 2020 racarla96
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================
+*/
+
+#include "SPIdevFifo.h"
+
+/** Default constructor.
+ * @param dev Sensor owning the FIFO
+ * @param countReg First register of the FIFO byte count (16 bits)
+ * @param dataReg FIFO data register
+ * @param frameSize Bytes per FIFO frame (one sample of every enabled channel, up to 127)
+ * @param sampleRate Rate at which the sensor pushes frames, in Hz
+ */
+SPIdevFifo::SPIdevFifo(SPIdev *dev, uint8_t countReg, uint8_t dataReg, uint8_t frameSize, uint16_t sampleRate) {
+    this->dev = dev;
+    this->countReg = countReg;
+    this->dataReg = dataReg;
+    this->frameSize = constrain(frameSize, (uint8_t) 1, (uint8_t) 127);
+    framePeriod = (1000000UL << 4) / max(sampleRate, (uint16_t) 1);
+    watermark = 0;
+    overflowBit = 0xFF;
+    tolerance = 1;
+    handler = NULL;
+    context = NULL;
+    ring = NULL;
+    ringFrames = 0;
+    ringPending = false;
+    gapHead = gapTail = 0;
+    head = tail = 0;
+    frames = 0;
+    lostFrames = 0;
+    gaps = 0;
+    overflows = 0;
+    reset();
+}
+
+/** Use the overflow flag of the sensor to detect lost frames.
+ * @param statusReg Register holding the flag (read clears it on most sensors)
+ * @param bitNum Bit position of the flag (0-7)
+ */
+void SPIdevFifo::setOverflowFlag(uint8_t statusReg, uint8_t bitNum) {
+    this->statusReg = statusReg;
+    overflowBit = bitNum;
+}
+
+/** Set the function receiving the drained frames and gap records.
+ * @param handler Function to call, NULL to only fill the drain buffer
+ * @param context Pointer passed back to the handler
+ */
+void SPIdevFifo::setHandler(SPIdevFifoHandler handler, void *context) {
+    this->handler = handler;
+    this->context = context;
+}
+
+/** Set how many frames short of the expected count an interval may be before
+ * it is reported as a gap (default 1, to absorb clock drift and jitter).
+ * @param frames Tolerance in frames
+ */
+void SPIdevFifo::setTolerance(uint8_t frames) {
+    tolerance = frames;
+}
+
+/** Set the fill level at which the FIFO should be drained.
+ * Keep it below the FIFO size by more than the worst service latency.
+ * @param bytes Watermark in bytes (0 = drain on every scheduler pass)
+ */
+void SPIdevFifo::setWatermark(uint16_t bytes) {
+    watermark = bytes / frameSize;
+}
+
+/** Forget the timing history, e.g. after the sensor FIFO has been reset.
+ * The next drain starts a new stream and never reports a gap.
+ */
+void SPIdevFifo::reset() {
+    started = false;
+    lastCount = micros();
+    elapsed = 0;
+    remaining = 0;
+    level = 0;
+}
+
+/** Drain the FIFO.
+ * Reads as many whole frames as the FIFO holds and the buffer fits, emitting a
+ * gap record first when frames were lost since the previous drain. Frames that
+ * do not fit stay in the FIFO for the next drain.
+ * @param buffer Buffer to read the frames in
+ * @param size Size of the buffer in bytes
+ * @return Number of frames drained (-1 indicates failure)
+ */
+int16_t SPIdevFifo::drain(uint8_t *buffer, uint16_t size) {
+    return drain(buffer, size, NULL, 0);
+}
+
+/** Drain the FIFO into two buffer segments, filled in order.
+ */
+int16_t SPIdevFifo::drain(uint8_t *buffer, uint16_t size, uint8_t *wrap, uint16_t wrapSize) {
+    uint16_t count;
+    if (dev->readWord(countReg, &count) < 0) return -1;
+    uint32_t now = micros();
+    level = count;
+
+    uint16_t available = count / frameSize;
+    uint16_t lost = 0;
+
+    bool overflow = false;
+    if (overflowBit != 0xFF) {
+        uint8_t flag;
+        if (dev->readBit(statusReg, overflowBit, &flag) < 0) return -1;
+        overflow = flag != 0;
+    }
+
+    if (started) {
+        // frames pushed since the last count read, against the frames the
+        // measured fill rate predicts for the same interval
+        uint16_t arrived = (available > remaining) ? available - remaining : 0;
+        elapsed += (now - lastCount) << 4;
+        uint32_t expected = elapsed / framePeriod;
+        elapsed -= expected * framePeriod;
+
+        // allow ~3% of jitter on top of the fixed tolerance
+        if (expected > (uint32_t) arrived + tolerance + expected / 32) {
+            lost = (uint16_t) min(expected - arrived, (uint32_t) 0xFFFF);
+        }
+
+        // learn the fill rate (1/8 weight per drain), but not from intervals
+        // too short to be a rate drift, where arrivals were capped by the FIFO
+        if (arrived > 0 && !overflow && (uint32_t) arrived * 8 >= expected * 7) {
+            int32_t measured = (int32_t) (((now - lastCount) << 4) / arrived);
+            framePeriod += (measured - (int32_t) framePeriod) / 8;
+        }
+    }
+    if (overflow) {
+        overflows++;
+        if (lost == 0) lost = 1; // at least one frame, the exact number is unknown
+    }
+    if (lost > 0) {
+        lostFrames += lost;
+        gaps++;
+        emit(NULL, 0, lost);
+    }
+    started = true;
+    lastCount = now;
+
+    // fill the first segment, then the second one (ring buffer wrap-around)
+    uint16_t first = min(available, (uint16_t) (size / frameSize));
+    uint16_t second = min((uint16_t) (available - first), (uint16_t) (wrapSize / frameSize));
+    if (!burst(buffer, first) || !burst(wrap, second)) return -1;
+
+    uint16_t done = first + second;
+    remaining = available - done;
+    frames += done;
+
+    if (first > 0) emit(buffer, first, 0);
+    if (second > 0) emit(wrap, second, 0);
+    return done;
+}
+
+/** Read whole frames out of the FIFO, in bursts of at most 127 bytes (the
+ * largest count readBytes can report).
+ * @param buffer Buffer to read the frames in
+ * @param count Number of frames to read
+ * @return Status of operation (true = success)
+ */
+bool SPIdevFifo::burst(uint8_t *buffer, uint16_t count) {
+    uint8_t chunk = 127 / frameSize;
+    while (count > 0) {
+        uint8_t n = (uint8_t) min(count, (uint16_t) chunk);
+        if (dev->readBytes(dataReg, n * frameSize, buffer) < 0) return false;
+        buffer += n * frameSize;
+        count -= n;
+    }
+    return true;
+}
+
+/** Drain the FIFO into the ring buffer whenever its watermark interrupt fires.
+ * The interrupt is registered with SPI.usingInterrupt, so it never fires in
+ * the middle of another SPI transaction. The handler, if any, is then called
+ * from interrupt context.
+ * @param storage Ring buffer storage, its size is rounded down to whole frames
+ * @param size Size of the storage in bytes, at least two frames (one slot
+ *        always stays empty)
+ * @param pin Pin wired to the watermark interrupt output of the sensor
+ * @param mode Interrupt trigger (RISING, FALLING, CHANGE)
+ * @return Status of operation (false = storage too small, pin without
+ *         interrupt or no free slot)
+ */
+bool SPIdevFifo::attachWatermarkInterrupt(uint8_t *storage, uint16_t size, uint8_t pin, int mode) {
+    if (size / frameSize < 2) return false;
+    int irq = digitalPinToInterrupt(pin);
+    if (irq == NOT_AN_INTERRUPT) return false;
+
+    uint8_t slot = 0;
+    while (slot < SPIDEV_FIFO_MAX_INTERRUPTS && interruptFifos[slot] != NULL) slot++;
+    if (slot == SPIDEV_FIFO_MAX_INTERRUPTS) return false;
+
+    ring = storage;
+    ringFrames = size / frameSize;
+    head = tail = 0;
+    ringPending = false;
+    gapHead = gapTail = 0;
+    interruptFifos[slot] = this;
+
+    SPI.usingInterrupt(irq);
+    attachInterrupt(irq, interruptHandlers[slot], mode);
+    return true;
+}
+
+/** Drain the FIFO into the ring buffer.
+ * Called from the watermark interrupt, or directly by any other event source
+ * (e.g. a timer, or a test harness standing in for the interrupt line).
+ * Frames that do not fit in the ring buffer stay in the sensor FIFO, and
+ * ringRead() drains them once it has made room: the watermark output of the
+ * sensor stays asserted meanwhile, so no new edge would.
+ */
+void SPIdevFifo::onWatermark() {
+    if (ring == NULL) return;
+
+    // one slot is kept empty to tell a full ring from an empty one
+    uint16_t t = tail;
+    uint16_t space = (t > head) ? t - head - 1 : ringFrames - head + t - 1;
+    uint16_t contiguous = min(space, (uint16_t) (ringFrames - head));
+
+    uint16_t at = head;
+    uint32_t lostBefore = lostFrames;
+    int16_t n = drain(ring + head * frameSize, contiguous * frameSize,
+                      ring, (space - contiguous) * frameSize);
+    if (lostFrames != lostBefore) addGap(at, lostFrames - lostBefore);
+    if (n > 0) {
+        uint16_t h = head + n;
+        head = (h >= ringFrames) ? h - ringFrames : h;
+    }
+    ringPending = (n < 0 || remaining > 0);
+}
+
+/** Record a gap before the frame the next drain writes at a ring index.
+ * @param at Ring index of the first frame after the gap
+ * @param lost Number of frames missing
+ */
+void SPIdevFifo::addGap(uint16_t at, uint32_t lost) {
+    uint8_t newest = (gapHead + SPIDEV_FIFO_MAX_GAPS - 1) % SPIDEV_FIFO_MAX_GAPS;
+    uint8_t next = (gapHead + 1) % SPIDEV_FIFO_MAX_GAPS;
+    if (gapHead != gapTail && (gapAt[newest] == at || next == gapTail)) {
+        // no frame in between, or no free record: add to the newest gap
+        gapLost[newest] = (uint16_t) min((uint32_t) gapLost[newest] + lost, (uint32_t) 0xFFFF);
+        return;
+    }
+    gapAt[gapHead] = at;
+    gapLost[gapHead] = (uint16_t) min(lost, (uint32_t) 0xFFFF);
+    gapHead = next;
+}
+
+/** Number of frames waiting in the ring buffer.
+ */
+uint16_t SPIdevFifo::ringAvailable() {
+    noInterrupts();
+    uint16_t h = head;
+    interrupts();
+    return (h >= tail) ? h - tail : ringFrames - tail + h;
+}
+
+/** Copy frames out of the ring buffer.
+ * A read never spans a gap: it stops at the next one, and the following
+ * read reports the frames missing there through lost, before its frames.
+ * If the last drain left frames in the sensor FIFO, they are drained into
+ * the room just made, from the calling context.
+ * @param frames Buffer to copy the frames to
+ * @param count Maximum number of frames to copy
+ * @param lost Set to the number of frames missing before the frames copied
+ *        (0 = none), may be NULL
+ * @return Number of frames copied
+ */
+uint16_t SPIdevFifo::ringRead(uint8_t *frames, uint16_t count, uint16_t *lost) {
+    uint16_t t = tail;
+    uint32_t missing = 0;
+    noInterrupts();
+    while (gapTail != gapHead && gapAt[gapTail] == t) {
+        missing += gapLost[gapTail];
+        gapTail = (gapTail + 1) % SPIDEV_FIFO_MAX_GAPS;
+    }
+    // frames up to the next gap, or all of them
+    uint16_t end = (gapTail != gapHead) ? gapAt[gapTail] : head;
+    interrupts();
+    if (lost != NULL) *lost = (uint16_t) min(missing, (uint32_t) 0xFFFF);
+
+    count = min(count, (uint16_t) ((end >= t) ? end - t : ringFrames - t + end));
+    for (uint16_t i = 0; i < count; i++) {
+        memcpy(frames + i * frameSize, ring + t * frameSize, frameSize);
+        if (++t == ringFrames) t = 0;
+    }
+    noInterrupts();
+    tail = t;
+    interrupts();
+
+    if (ringPending) {
+        // the session transaction masks the watermark interrupt (see
+        // SPI.usingInterrupt), so this drain cannot race the handler's
+        dev->beginSession();
+        onWatermark();
+        dev->endSession();
+    }
+    return count;
+}
+
+// Watermark interrupts dispatch to the FIFO registered in their slot
+SPIdevFifo *SPIdevFifo::interruptFifos[SPIDEV_FIFO_MAX_INTERRUPTS] = {};
+
+void SPIdevFifo::onInterrupt0() { interruptFifos[0]->onWatermark(); }
+void SPIdevFifo::onInterrupt1() { interruptFifos[1]->onWatermark(); }
+void SPIdevFifo::onInterrupt2() { interruptFifos[2]->onWatermark(); }
+void SPIdevFifo::onInterrupt3() { interruptFifos[3]->onWatermark(); }
+
+void (*const SPIdevFifo::interruptHandlers[SPIDEV_FIFO_MAX_INTERRUPTS])() = {
+    onInterrupt0, onInterrupt1, onInterrupt2, onInterrupt3
+};
+
+/** Time at which the FIFO reaches its watermark.
+ * @return micros() timestamp, in the past when a drain is already due
+ */
+uint32_t SPIdevFifo::dueAt() {
+    if (!started || remaining >= watermark) return lastCount;
+    return lastCount + (((uint32_t) (watermark - remaining) * framePeriod) >> 4);
+}
+
+/** Pass frames or a gap record to the handler, if any.
+ */
+void SPIdevFifo::emit(const uint8_t *frames, uint16_t count, uint16_t lost) {
+    if (handler != NULL) handler(context, frames, count, lost);
+}
+
+/** Default constructor.
+ * @param buffer Buffer shared by all the drains, see SPIdevFifo::drain
+ * @param size Size of the buffer in bytes
+ */
+SPIdevFifoScheduler::SPIdevFifoScheduler(uint8_t *buffer, uint16_t size) {
+    this->buffer = buffer;
+    this->size = size;
+    count = 0;
+    batchWindow = 1000;
+}
+
+/** Add a FIFO to schedule.
+ * @param fifo FIFO to drain, with its watermark and handler set
+ * @return Status of operation (false = too many FIFOs)
+ */
+bool SPIdevFifoScheduler::add(SPIdevFifo *fifo) {
+    if (count >= SPIDEV_SCHEDULER_MAX_FIFOS) return false;
+    fifos[count++] = fifo;
+    return true;
+}
+
+/** Set how early a FIFO may be drained to join a batch (default 1000 us).
+ * @param micros Batch window in microseconds
+ */
+void SPIdevFifoScheduler::setBatchWindow(uint32_t micros) {
+    batchWindow = micros;
+}
+
+/** Drain the FIFOs that are due, call it as often as possible.
+ * @return Number of FIFOs drained
+ */
+uint8_t SPIdevFifoScheduler::service() {
+    uint32_t now = micros();
+    bool due = false;
+    for (uint8_t i = 0; i < count && !due; i++) {
+        due = (int32_t) (fifos[i]->dueAt() - now) <= 0;
+    }
+    if (!due) return 0;
+
+    // FIFOs in the batch, one bit each
+    uint16_t batch = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        if ((int32_t) (fifos[i]->dueAt() - now) <= (int32_t) batchWindow) batch |= 1 << i;
+    }
+
+    // drain the batch device by device, each device in a single session
+    uint8_t drained = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        if (!(batch & (1 << i))) continue;
+        SPIdev *dev = fifos[i]->getDevice();
+        dev->beginSession();
+        for (uint8_t j = i; j < count; j++) {
+            if (!(batch & (1 << j)) || fifos[j]->getDevice() != dev) continue;
+            batch &= ~(1 << j);
+            fifos[j]->drain(buffer, size);
+            drained++;
+        }
+        dev->endSession();
+    }
+    return drained;
+}
+
+/** Time at which the next FIFO will be due.
+ * @return micros() timestamp, e.g. to sleep until then
+ */
+uint32_t SPIdevFifoScheduler::nextDue() {
+    uint32_t now = micros();
+    uint32_t next = now + 0x7FFFFFFF;
+    for (uint8_t i = 0; i < count; i++) {
+        uint32_t t = fifos[i]->dueAt();
+        if ((int32_t) (t - next) < 0) next = t;
+    }
+    return next;
+}
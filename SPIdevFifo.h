@@ -0,0 +1,160 @@
+// SPIdev library collection - Sensor FIFO drain engine header file
+// Reads buffered samples out of sensor FIFOs and tracks lost samples
+// 2020-05-03 by Rafael Carbonell <racarla96@gmail.com>
+//
+// Changelog:
+//      2020-05-?? - initial release
+
+/* ============================================
+SPIdev device library code 
+
+MIT License
+
+Copyright (c) 2020 racarla96
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================
+*/
+
+#ifndef _SPIDEVFIFO_H_
+#define _SPIDEVFIFO_H_
+
+#include "SPIdev.h"
+
+// Maximum number of FIFOs handled by a SPIdevFifoScheduler (at most 16)
+#define SPIDEV_SCHEDULER_MAX_FIFOS      8
+
+// Maximum number of FIFOs drained from a watermark interrupt
+#define SPIDEV_FIFO_MAX_INTERRUPTS      4
+
+// Gap records kept with the ring buffer of a SPIdevFifo until ringRead()
+// reports them, further gaps are merged into the newest record
+#define SPIDEV_FIFO_MAX_GAPS            4
+
+/*
+    Called for every block of frames drained from the FIFO, in stream order.
+    A call with frames == NULL and count == 0 is a gap record: lost frames are
+    missing from the stream at that point.
+*/
+typedef void (*SPIdevFifoHandler)(void *context, const uint8_t *frames, uint16_t count, uint16_t lost);
+
+/*
+    Drains the FIFO of a sensor: reads its fill level from a 16-bit byte count
+    register, then bursts the whole frames it holds out of its data register.
+    Sample loss is detected from the overflow flag of the sensor (if any) and
+    by comparing the frames that arrived between two drains with the number
+    expected from the sample rate and the elapsed time. The rate starts at the
+    configured one and then tracks the rate measured from the count reads, so
+    the drift of the sensor clock is not mistaken for lost frames.
+*/
+class SPIdevFifo {
+    public:
+        // Loss counters
+        uint32_t frames;        // frames drained
+        uint32_t lostFrames;    // frames known to be missing from the stream
+        uint16_t gaps;          // number of gap records emitted
+        uint16_t overflows;     // number of overflow flags seen
+        uint16_t level;         // FIFO fill level (bytes) at the last drain
+
+        SPIdevFifo(SPIdev *dev, uint8_t countReg, uint8_t dataReg, uint8_t frameSize, uint16_t sampleRate);
+
+        void setOverflowFlag(uint8_t statusReg, uint8_t bitNum);
+        void setHandler(SPIdevFifoHandler handler, void *context = NULL);
+        void setTolerance(uint8_t frames);
+        void setWatermark(uint16_t bytes);
+        void reset();
+        SPIdev *getDevice() { return dev; }
+
+        int16_t drain(uint8_t *buffer, uint16_t size);
+        uint32_t dueAt();
+
+        bool attachWatermarkInterrupt(uint8_t *storage, uint16_t size, uint8_t pin, int mode = RISING);
+        void onWatermark();
+        uint16_t ringAvailable();
+        uint16_t ringRead(uint8_t *frames, uint16_t count, uint16_t *lost = NULL);
+
+    private:
+        SPIdev *dev;
+        uint8_t countReg;
+        uint8_t dataReg;
+        uint8_t frameSize;
+        uint8_t statusReg;
+        uint8_t overflowBit;    // 0xFF when the sensor has no overflow flag
+        uint8_t tolerance;
+        uint32_t framePeriod;   // measured time between frames, 1/16 us units
+        uint16_t watermark;     // frames at which a drain is due
+        uint32_t elapsed;       // time not yet accounted for by expected frames, 1/16 us units
+        uint32_t lastCount;     // micros() at the last count read
+        uint16_t remaining;     // frames left in the FIFO by the last drain
+        bool started;
+        SPIdevFifoHandler handler;
+        void *context;
+
+        // ring buffer filled by the watermark interrupt (frame indexes)
+        uint8_t *ring;
+        uint16_t ringFrames;
+        volatile uint16_t head;
+        volatile uint16_t tail;
+        volatile bool ringPending;  // the last drain left frames in the sensor FIFO
+        // gaps in the ring: index of the frame following each gap, and the
+        // number of frames missing before it
+        uint16_t gapAt[SPIDEV_FIFO_MAX_GAPS];
+        uint16_t gapLost[SPIDEV_FIFO_MAX_GAPS];
+        volatile uint8_t gapHead;
+        volatile uint8_t gapTail;
+
+        static SPIdevFifo *interruptFifos[SPIDEV_FIFO_MAX_INTERRUPTS];
+        static void (*const interruptHandlers[SPIDEV_FIFO_MAX_INTERRUPTS])();
+        static void onInterrupt0();
+        static void onInterrupt1();
+        static void onInterrupt2();
+        static void onInterrupt3();
+
+        int16_t drain(uint8_t *buffer, uint16_t size, uint8_t *wrap, uint16_t wrapSize);
+        bool burst(uint8_t *buffer, uint16_t count);
+        void addGap(uint16_t at, uint32_t lost);
+        void emit(const uint8_t *frames, uint16_t count, uint16_t lost);
+};
+
+/*
+    Drains several FIFOs just before they reach their watermark, from the fill
+    rate each one measured. When one FIFO is due, the others due within the
+    batch window are drained in the same service() call, with as many bytes
+    per burst as possible; the drains of FIFOs on the same device run in one
+    bus session, so their handlers must not access another device.
+*/
+class SPIdevFifoScheduler {
+    public:
+        SPIdevFifoScheduler(uint8_t *buffer, uint16_t size);
+
+        bool add(SPIdevFifo *fifo);
+        void setBatchWindow(uint32_t micros);
+
+        uint8_t service();
+        uint32_t nextDue();
+
+    private:
+        SPIdevFifo *fifos[SPIDEV_SCHEDULER_MAX_FIFOS];
+        uint8_t count;
+        uint8_t *buffer;
+        uint16_t size;
+        uint32_t batchWindow;
+};
+
+#endif
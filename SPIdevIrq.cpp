@@ -0,0 +1,113 @@
+// SPIdev library collection - Shared interrupt line dispatcher
+// Reads the interrupt status of every device on a line and calls its handlers
+// 2020-05-03 by Rafael Carbonell <racarla96@gmail.com>
+//
+// Changelog:
+//      2020-05-?? - initial release
+
+/* ============================================
+SPIdev device library code 
+
+MIT License
+
+Copyright (c) 2020 racarla96
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================
+*/
+
+#include "SPIdevIrq.h"
+
+/** Default constructor.
+ * @param pin Pin wired to the shared interrupt line
+ * @param activeLevel Level of the line when a device requests attention
+ */
+SPIdevIrqLine::SPIdevIrqLine(uint8_t pin, uint8_t activeLevel) {
+    this->pin = pin;
+    this->activeLevel = activeLevel;
+    count = 0;
+    pinMode(pin, activeLevel == LOW ? INPUT_PULLUP : INPUT);
+}
+
+/** Add a device driving the line.
+ * @param dev Device to read the interrupt status of
+ * @param statusReg Interrupt status register (cleared on read on most devices)
+ * @param context Pointer passed to the handlers of this device
+ * @return Source number to register the handlers with (-1 = too many sources)
+ */
+int8_t SPIdevIrqLine::addSource(SPIdev *dev, uint8_t statusReg, void *context) {
+    if (count >= SPIDEV_IRQ_MAX_SOURCES) return -1;
+    devs[count] = dev;
+    statusRegs[count] = statusReg;
+    contexts[count] = context;
+    masks[count] = 0;
+    memset(handlers[count], 0, sizeof(handlers[count]));
+    return count++;
+}
+
+/** Set the handler of a status bit.
+ * @param source Source number returned by addSource
+ * @param bitNum Bit position in the status register (0-7)
+ * @param handler Function to call when the bit is set, NULL to ignore the bit
+ * @return Status of operation (false = unknown source or bit)
+ */
+bool SPIdevIrqLine::on(uint8_t source, uint8_t bitNum, SPIdevIrqHandler handler) {
+    if (source >= count || bitNum > 7) return false;
+    handlers[source][bitNum] = handler;
+    if (handler != NULL) {
+        masks[source] |= 1 << bitNum;
+    } else {
+        masks[source] &= ~(1 << bitNum);
+    }
+    return true;
+}
+
+/** Dispatch if the line is asserted, call it from loop().
+ * @return True if the line was asserted
+ */
+bool SPIdevIrqLine::service() {
+    if (digitalRead(pin) != activeLevel) return false;
+    dispatch();
+    return true;
+}
+
+/** Read every status register and call the handlers of the set bits.
+ * All the registers are read before the first handler runs, so the time a
+ * handler takes does not delay the status reads of the other devices.
+ * @return Number of handlers called
+ */
+uint8_t SPIdevIrqLine::dispatch() {
+    uint8_t status[SPIDEV_IRQ_MAX_SOURCES];
+    for (uint8_t s = 0; s < count; s++) {
+        // a source whose status cannot be read reports nothing
+        if (devs[s]->readByte(statusRegs[s], &status[s]) < 0) status[s] = 0;
+    }
+
+    uint8_t called = 0;
+    for (uint8_t s = 0; s < count; s++) {
+        unsigned int bits = status[s] & masks[s];
+        while (bits) {
+            uint8_t bit = __builtin_ctz(bits);
+            handlers[s][bit](contexts[s], s, bit);
+            bits &= bits - 1; // clear the lowest set bit
+            called++;
+        }
+    }
+    return called;
+}
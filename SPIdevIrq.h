@@ -0,0 +1,75 @@
+// SPIdev library collection - Shared interrupt line dispatcher header file
+// Reads the interrupt status of every device on a line and calls its handlers
+// 2020-05-03 by Rafael Carbonell <racarla96@gmail.com>
+//
+// Changelog:
+//      2020-05-?? - initial release
+
+/* ============================================
+SPIdev device library code 
+
+MIT License
+
+Copyright (c) 2020 racarla96
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================
+*/
+
+#ifndef _SPIDEVIRQ_H_
+#define _SPIDEVIRQ_H_
+
+#include "SPIdev.h"
+
+// Maximum number of devices sharing a SPIdevIrqLine
+#define SPIDEV_IRQ_MAX_SOURCES      4
+
+/*
+    Called for every set bit of an interrupt status register.
+*/
+typedef void (*SPIdevIrqHandler)(void *context, uint8_t source, uint8_t bitNum);
+
+/*
+    Interrupt line shared by several devices (wired-OR, open drain). When it
+    is asserted, the interrupt status register of every device on it is read
+    in one batch, then the handlers are called through a table indexed by
+    source and bit: only the set bits are visited, lowest first.
+*/
+class SPIdevIrqLine {
+    public:
+        SPIdevIrqLine(uint8_t pin, uint8_t activeLevel = LOW);
+
+        int8_t addSource(SPIdev *dev, uint8_t statusReg, void *context = NULL);
+        bool on(uint8_t source, uint8_t bitNum, SPIdevIrqHandler handler);
+
+        bool service();
+        uint8_t dispatch();
+
+    private:
+        uint8_t pin;
+        uint8_t activeLevel;
+        uint8_t count;
+        SPIdev *devs[SPIDEV_IRQ_MAX_SOURCES];
+        uint8_t statusRegs[SPIDEV_IRQ_MAX_SOURCES];
+        uint8_t masks[SPIDEV_IRQ_MAX_SOURCES];  // bits with a handler
+        void *contexts[SPIDEV_IRQ_MAX_SOURCES];
+        SPIdevIrqHandler handlers[SPIDEV_IRQ_MAX_SOURCES][8];
+};
+
+#endif
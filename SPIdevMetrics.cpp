@@ -0,0 +1,232 @@
+// SPIdev library collection - Metrics exposition
+// Writes SPIdev counters in the Prometheus text exposition format
+// 2020-05-03 by Rafael Carbonell <racarla96@gmail.com>
+//
+// Changelog:
+//      2020-05-?? - initial release
+
+/* ============================================
+SPIdev device library code 
+
+MIT License
+
+Copyright (c) 2020 racarla96
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================
+*/
+
+#include "SPIdevMetrics.h"
+
+// Kinds of sources
+#define METRICS_DEVICE      0
+#define METRICS_FIFO        1
+#define METRICS_PINGPONG    2
+
+// Counters read from the sources
+#define FIELD_CRC_ERRORS    0
+#define FIELD_CRC_FAILURES  1
+#define FIELD_FRAMES        2
+#define FIELD_LOST_FRAMES   3
+#define FIELD_GAPS          4
+#define FIELD_OVERFLOWS     5
+#define FIELD_LEVEL         6
+#define FIELD_OVERRUNS      7
+
+// Label of the source of each kind of sample
+static const char *const labels[] = {"device", "fifo", "buffer"};
+
+const SPIdevMetrics::Family SPIdevMetrics::families[] = {
+    #ifdef SPIDEV_CRC
+    {"spidev_crc_errors_total", "Frames received with a bad CRC.", "counter", METRICS_DEVICE, FIELD_CRC_ERRORS},
+    {"spidev_crc_failures_total", "Reads given up after all CRC retries.", "counter", METRICS_DEVICE, FIELD_CRC_FAILURES},
+    #endif
+    {"spidev_fifo_frames_total", "Frames drained from the FIFO.", "counter", METRICS_FIFO, FIELD_FRAMES},
+    {"spidev_fifo_lost_frames_total", "Frames known to be missing from the stream.", "counter", METRICS_FIFO, FIELD_LOST_FRAMES},
+    {"spidev_fifo_gaps_total", "Gaps in the stream, e.g. missed drain deadlines.", "counter", METRICS_FIFO, FIELD_GAPS},
+    {"spidev_fifo_overflows_total", "Overflow flags seen.", "counter", METRICS_FIFO, FIELD_OVERFLOWS},
+    {"spidev_fifo_level_bytes", "FIFO fill level at the last drain.", "gauge", METRICS_FIFO, FIELD_LEVEL},
+    {"spidev_pingpong_overruns_total", "Acquisitions dropped with both buffers full.", "counter", METRICS_PINGPONG, FIELD_OVERRUNS},
+};
+
+/** Default constructor.
+ */
+SPIdevMetrics::SPIdevMetrics() {
+    count = 0;
+}
+
+/** Expose the counters of a device.
+ * @param dev Device to expose
+ * @param name Value of its device label, must stay valid
+ * @return Status of operation (true = success)
+ */
+bool SPIdevMetrics::add(SPIdev *dev, const char *name) {
+    return add(dev, name, METRICS_DEVICE);
+}
+
+/** Expose the frame and loss counters of a FIFO.
+ * @param fifo FIFO to expose
+ * @param name Value of its fifo label, must stay valid
+ * @return Status of operation (true = success)
+ */
+bool SPIdevMetrics::add(SPIdevFifo *fifo, const char *name) {
+    return add(fifo, name, METRICS_FIFO);
+}
+
+/** Expose the overruns of ping-pong buffers.
+ * @param pingPong Buffers to expose
+ * @param name Value of their buffer label, must stay valid
+ * @return Status of operation (true = success)
+ */
+bool SPIdevMetrics::add(SPIdevPingPong *pingPong, const char *name) {
+    return add(pingPong, name, METRICS_PINGPONG);
+}
+
+/** Write every metric.
+ * @param out Where to write the exposition, e.g. Serial or a network client
+ */
+void SPIdevMetrics::print(Print &out) {
+    #ifdef SPIDEV_BUS_STATS
+        SPIdevBusStats bus;
+        SPIdev::busStats(bus);
+
+        printHeader(out, "spidev_bus_window_seconds", "Length of the bus statistics window.", "gauge");
+        out.print("spidev_bus_window_seconds ");
+        printSeconds(out, bus.elapsedMicros);
+        out.print('\n');
+        printHeader(out, "spidev_bus_busy_seconds_total", "Time with a device selected.", "counter");
+        out.print("spidev_bus_busy_seconds_total ");
+        printSeconds(out, bus.busyMicros);
+        out.print('\n');
+        printHeader(out, "spidev_bus_bytes_total", "Bytes transferred, register addresses included.", "counter");
+        out.print("spidev_bus_bytes_total ");
+        out.print(bus.bytes);
+        out.print('\n');
+        printHeader(out, "spidev_bus_transactions_total", "Bus transactions.", "counter");
+        out.print("spidev_bus_transactions_total ");
+        out.print(bus.transactions);
+        out.print('\n');
+
+        // bucket n holds gaps of 2^n to 2^(n+1)-1 us; the sum of the gaps is
+        // not recorded, so the histogram has no _sum sample
+        printHeader(out, "spidev_bus_idle_gap_seconds", "Idle time between transactions.", "histogram");
+        uint32_t cumulative = 0;
+        for (uint8_t i = 0; i < SPIDEV_IDLE_GAP_BUCKETS; i++) {
+            cumulative += bus.idleGaps[i];
+            out.print("spidev_bus_idle_gap_seconds_bucket{le=\"");
+            if (i < SPIDEV_IDLE_GAP_BUCKETS - 1) {
+                printSeconds(out, ((uint32_t) 2 << i) - 1);
+            } else {
+                out.print("+Inf");
+            }
+            out.print("\"} ");
+            out.print(cumulative);
+            out.print('\n');
+        }
+        out.print("spidev_bus_idle_gap_seconds_count ");
+        out.print(cumulative);
+        out.print('\n');
+    #endif
+
+    for (uint8_t f = 0; f < sizeof(families) / sizeof(families[0]); f++) {
+        const Family &family = families[f];
+        bool header = false;
+        for (uint8_t i = 0; i < count; i++) {
+            if (sources[i].kind != family.kind) continue;
+            if (!header) {
+                printHeader(out, family.name, family.help, family.type);
+                header = true;
+            }
+            out.print(family.name);
+            out.print("{");
+            out.print(labels[family.kind]);
+            out.print("=\"");
+            out.print(sources[i].name);
+            out.print("\"} ");
+            out.print(value(sources[i], family.field));
+            out.print('\n');
+        }
+    }
+}
+
+/** Append a source.
+ * @return Status of operation (true = success)
+ */
+bool SPIdevMetrics::add(void *object, const char *name, uint8_t kind) {
+    if (count >= SPIDEV_METRICS_MAX_SOURCES) return false;
+    sources[count].object = object;
+    sources[count].name = name;
+    sources[count].kind = kind;
+    count++;
+    return true;
+}
+
+/** Copy a counter of a source, with interrupts disabled for the copy only.
+ * @param source Source to read
+ * @param field Counter to read
+ * @return Value of the counter
+ */
+uint32_t SPIdevMetrics::value(const Source &source, uint8_t field) {
+    uint32_t v = 0;
+    noInterrupts();
+    switch (field) {
+        #ifdef SPIDEV_CRC
+        case FIELD_CRC_ERRORS:   v = ((SPIdev *) source.object)->crcErrors; break;
+        case FIELD_CRC_FAILURES: v = ((SPIdev *) source.object)->crcFailures; break;
+        #endif
+        case FIELD_FRAMES:       v = ((SPIdevFifo *) source.object)->frames; break;
+        case FIELD_LOST_FRAMES:  v = ((SPIdevFifo *) source.object)->lostFrames; break;
+        case FIELD_GAPS:         v = ((SPIdevFifo *) source.object)->gaps; break;
+        case FIELD_OVERFLOWS:    v = ((SPIdevFifo *) source.object)->overflows; break;
+        case FIELD_LEVEL:        v = ((SPIdevFifo *) source.object)->level; break;
+        case FIELD_OVERRUNS:     v = ((SPIdevPingPong *) source.object)->overruns; break;
+    }
+    interrupts();
+    return v;
+}
+
+/** Write the HELP and TYPE lines of a metric family.
+ * Lines end with a bare line feed, as the format requires (println would
+ * end them with a carriage return too).
+ */
+void SPIdevMetrics::printHeader(Print &out, const char *name, const char *help, const char *type) {
+    out.print("# HELP ");
+    out.print(name);
+    out.print(" ");
+    out.print(help);
+    out.print('\n');
+    out.print("# TYPE ");
+    out.print(name);
+    out.print(" ");
+    out.print(type);
+    out.print('\n');
+}
+
+/** Write a duration in seconds, exactly (no float rounding).
+ * @param micros Duration in microseconds
+ */
+void SPIdevMetrics::printSeconds(Print &out, uint32_t micros) {
+    out.print(micros / 1000000UL);
+    out.print(".");
+    uint32_t fraction = micros % 1000000UL;
+    for (uint32_t digit = 100000UL; digit > 1 && fraction < digit; digit /= 10) {
+        out.print("0");
+    }
+    out.print(fraction);
+}
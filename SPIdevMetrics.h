@@ -0,0 +1,92 @@
+// SPIdev library collection - Metrics exposition header file
+// Writes SPIdev counters in the Prometheus text exposition format
+// 2020-05-03 by Rafael Carbonell <racarla96@gmail.com>
+//
+// Changelog:
+//      2020-05-?? - initial release
+
+/* ============================================
+SPIdev device library code 
+
+MIT License
+
+Copyright (c) 2020 racarla96
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================
+*/
+
+#ifndef _SPIDEVMETRICS_H_
+#define _SPIDEVMETRICS_H_
+
+#include "SPIdev.h"
+#include "SPIdevFifo.h"
+#include "SPIdevPingPong.h"
+
+// Maximum number of devices, FIFOs and ping-pong buffers of a SPIdevMetrics
+#define SPIDEV_METRICS_MAX_SOURCES  8
+
+/*
+    Writes the library counters in the Prometheus text exposition format
+    (version 0.0.4) to any Print, e.g. the client of a scrape request or the
+    serial port of a gateway relaying it. Every value is copied with
+    interrupts disabled for the copy only, then formatted with interrupts
+    enabled, so a scrape never holds off an acquisition for longer than a
+    counter copy. Sources are labelled with the name they were added with.
+    Exposed: bus utilization and idle gaps (SPIDEV_BUS_STATS), CRC counters
+    per device (SPIDEV_CRC), frame and loss counters per FIFO, overruns per
+    ping-pong buffer.
+*/
+class SPIdevMetrics {
+    public:
+        SPIdevMetrics();
+
+        bool add(SPIdev *dev, const char *name);
+        bool add(SPIdevFifo *fifo, const char *name);
+        bool add(SPIdevPingPong *pingPong, const char *name);
+
+        void print(Print &out);
+
+    private:
+        struct Source {
+            void *object;
+            const char *name;
+            uint8_t kind;
+        };
+
+        struct Family {
+            const char *name;
+            const char *help;
+            const char *type;
+            uint8_t kind;       // kind of source the samples come from
+            uint8_t field;      // counter read from each source
+        };
+
+        static const Family families[];
+
+        Source sources[SPIDEV_METRICS_MAX_SOURCES];
+        uint8_t count;
+
+        bool add(void *object, const char *name, uint8_t kind);
+        static uint32_t value(const Source &source, uint8_t field);
+        static void printHeader(Print &out, const char *name, const char *help, const char *type);
+        static void printSeconds(Print &out, uint32_t micros);
+};
+
+#endif
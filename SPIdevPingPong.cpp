@@ -0,0 +1,115 @@
+// SPIdev library collection - Ping-pong acquisition buffers
+// Double buffering between an acquisition and the code processing it
+// 2020-05-03 by Rafael Carbonell <racarla96@gmail.com>
+//
+// Changelog:
+//      2020-05-?? - initial release
+
+/* ============================================
+SPIdev device library code 
+
+MIT License
+
+Copyright (c) 2020 racarla96
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================
+*/
+
+#include "SPIdevPingPong.h"
+
+// Keeps the compiler from moving buffer accesses across an ownership change
+#define SPIDEV_BARRIER()    __asm__ __volatile__ ("" ::: "memory")
+
+/** Default constructor.
+ * @param bufferA First buffer
+ * @param bufferB Second buffer
+ * @param size Size of each buffer in bytes
+ */
+SPIdevPingPong::SPIdevPingPong(uint8_t *bufferA, uint8_t *bufferB, uint16_t size) {
+    buffers[0] = bufferA;
+    buffers[1] = bufferB;
+    this->size = size;
+    lengths[0] = lengths[1] = 0;
+    full[0] = full[1] = 0;
+    fillIndex = readIndex = 0;
+    overruns = 0;
+}
+
+/** Buffer to acquire into next.
+ * @return Buffer of the size given to the constructor, NULL while the consumer holds both
+ */
+uint8_t *SPIdevPingPong::acquire() {
+    return full[fillIndex] ? NULL : buffers[fillIndex];
+}
+
+/** Hand the acquired buffer over to the consumer.
+ * @param length Number of bytes acquired
+ */
+void SPIdevPingPong::commit(uint16_t length) {
+    lengths[fillIndex] = length;
+    SPIDEV_BARRIER();
+    full[fillIndex] = 1;
+    fillIndex ^= 1;
+}
+
+/** Fill the next buffer with a burst read, e.g. from a FIFO data register.
+ * Safe to call from an interrupt registered with SPI.usingInterrupt.
+ * @param dev Device to read from
+ * @param regAddr Register to read from
+ * @return Number of bytes acquired (-1 = overrun or read error)
+ */
+int16_t SPIdevPingPong::fill(SPIdev *dev, uint8_t regAddr) {
+    uint8_t *buffer = acquire();
+    if (buffer == NULL) {
+        overruns++;
+        return -1;
+    }
+
+    // readBytes reads at most 127 bytes at a time
+    for (uint16_t done = 0; done < size; ) {
+        uint16_t left = size - done;
+        uint8_t chunk = min(left, (uint16_t) 127);
+        if (dev->readBytes(regAddr, chunk, buffer + done) != chunk) return -1;
+        done += chunk;
+    }
+
+    commit(size);
+    return size;
+}
+
+/** Next complete buffer, in acquisition order.
+ * @param length Container for the number of bytes in the buffer, may be NULL
+ * @return Buffer to process, NULL when none is complete
+ */
+uint8_t *SPIdevPingPong::available(uint16_t *length) {
+    if (!full[readIndex]) return NULL;
+    SPIDEV_BARRIER();
+    if (length != NULL) *length = lengths[readIndex];
+    return buffers[readIndex];
+}
+
+/** Give the buffer returned by available() back to the producer.
+ */
+void SPIdevPingPong::release() {
+    if (!full[readIndex]) return;
+    SPIDEV_BARRIER();
+    full[readIndex] = 0;
+    readIndex ^= 1;
+}
@@ -0,0 +1,73 @@
+// SPIdev library collection - Ping-pong acquisition buffers header file
+// Double buffering between an acquisition and the code processing it
+// 2020-05-03 by Rafael Carbonell <racarla96@gmail.com>
+//
+// Changelog:
+//      2020-05-?? - initial release
+
+/* ============================================
+SPIdev device library code 
+
+MIT License
+
+Copyright (c) 2020 racarla96
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================
+*/
+
+#ifndef _SPIDEVPINGPONG_H_
+#define _SPIDEVPINGPONG_H_
+
+#include "SPIdev.h"
+
+/*
+    Two buffers handed back and forth between a producer, which acquires into
+    one of them (e.g. from a data-ready interrupt), and a consumer processing
+    the other one. Each buffer has an ownership flag: the producer only sets
+    it once the buffer is complete, the consumer only clears it once it is
+    done, so neither ever sees a buffer the other is still working on and no
+    interrupts need to be masked. The producer only stalls when the consumer
+    still holds both buffers; such acquisitions are dropped and counted.
+*/
+class SPIdevPingPong {
+    public:
+        volatile uint16_t overruns;     // acquisitions dropped, both buffers full
+
+        SPIdevPingPong(uint8_t *bufferA, uint8_t *bufferB, uint16_t size);
+
+        // producer side
+        uint8_t *acquire();
+        void commit(uint16_t length);
+        int16_t fill(SPIdev *dev, uint8_t regAddr);
+
+        // consumer side
+        uint8_t *available(uint16_t *length = NULL);
+        void release();
+
+    private:
+        uint8_t *buffers[2];
+        uint16_t size;
+        uint16_t lengths[2];
+        volatile uint8_t full[2];       // ownership: 0 = producer, 1 = consumer
+        uint8_t fillIndex;              // only used by the producer
+        uint8_t readIndex;              // only used by the consumer
+};
+
+#endif
@@ -0,0 +1,143 @@
+// SPIdev library collection - Transaction queue
+// Runs queued accesses to the same device in a single bus session
+// 2020-05-03 by Rafael Carbonell <racarla96@gmail.com>
+//
+// Changelog:
+//      2020-05-?? - initial release
+
+/* ============================================
+SPIdev device library code 
+
+MIT License
+
+Copyright (c) 2020 racarla96
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================
+*/
+
+#include "SPIdevQueue.h"
+
+/** Default constructor.
+ */
+SPIdevQueue::SPIdevQueue() {
+    count = 0;
+    sessions = 0;
+    accesses = 0;
+}
+
+/** Queue a burst read.
+ * @param dev Device to read from
+ * @param regAddr First register to read from
+ * @param length Number of bytes to read
+ * @param data Buffer to store read data in, must stay valid until the access has run
+ * @param callback Function called with the result, may be NULL
+ * @param context Pointer passed to the callback
+ * @return Status of operation (true = queued, false = queue full)
+ */
+bool SPIdevQueue::read(SPIdev *dev, uint8_t regAddr, uint8_t length, uint8_t *data, SPIdevQueueCallback callback, void *context) {
+    return add(dev, regAddr, length, data, false, callback, context);
+}
+
+/** Queue a burst write.
+ * @param dev Device to write to
+ * @param regAddr First register to write to
+ * @param length Number of bytes to write
+ * @param data Buffer to copy new data from, must stay valid until the access has run
+ * @param callback Function called with the result, may be NULL
+ * @param context Pointer passed to the callback
+ * @return Status of operation (true = queued, false = queue full)
+ */
+bool SPIdevQueue::write(SPIdev *dev, uint8_t regAddr, uint8_t length, uint8_t *data, SPIdevQueueCallback callback, void *context) {
+    return add(dev, regAddr, length, data, true, callback, context);
+}
+
+/** Number of accesses waiting to run.
+ */
+uint8_t SPIdevQueue::pending() {
+    return count;
+}
+
+/** Run every queued access, one bus session per device.
+ * @return Number of accesses run
+ */
+uint8_t SPIdevQueue::flush() {
+    uint8_t n = count;
+    uint16_t done = 0;
+
+    for (uint8_t i = 0; i < n; i++) {
+        if (done & (1 << i)) continue;
+        SPIdev *dev = queue[i].dev;
+
+        dev->beginSession();
+        for (uint8_t j = i; j < n; j++) {
+            Access &a = queue[j];
+            if (a.dev != dev) continue;
+            if (a.write) {
+                a.result = dev->writeBytes(a.regAddr, a.length, a.data) ? a.length : -1;
+            } else {
+                // readBytes returns the length as int8_t, so compare it that way
+                bool read = dev->ready && dev->readBytes(a.regAddr, a.length, a.data) == (int8_t) a.length;
+                a.result = read ? a.length : -1;
+            }
+            done |= 1 << j;
+        }
+        dev->endSession();
+        sessions++;
+    }
+
+    // take the completed accesses out of the queue before calling back, so
+    // the callbacks may queue accesses or flush again
+    struct {
+        SPIdevQueueCallback callback;
+        void *context;
+        int16_t result;
+    } completed[SPIDEV_QUEUE_LENGTH];
+    for (uint8_t i = 0; i < n; i++) {
+        completed[i].callback = queue[i].callback;
+        completed[i].context = queue[i].context;
+        completed[i].result = queue[i].result;
+    }
+    count -= n;
+    memmove(queue, queue + n, count * sizeof(Access));
+    accesses += n;
+
+    for (uint8_t i = 0; i < n; i++) {
+        if (completed[i].callback != NULL) completed[i].callback(completed[i].context, completed[i].result);
+    }
+    return n;
+}
+
+/** Append an access to the queue.
+ * @return Status of operation (true = queued, false = queue full)
+ */
+bool SPIdevQueue::add(SPIdev *dev, uint8_t regAddr, uint8_t length, uint8_t *data, bool write, SPIdevQueueCallback callback, void *context) {
+    if (count >= SPIDEV_QUEUE_LENGTH) return false;
+
+    Access &a = queue[count++];
+    a.dev = dev;
+    a.regAddr = regAddr;
+    a.length = length;
+    a.data = data;
+    a.write = write;
+    a.callback = callback;
+    a.context = context;
+    a.result = -1;
+    return true;
+}
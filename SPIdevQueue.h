@@ -0,0 +1,88 @@
+// SPIdev library collection - Transaction queue header file
+// Runs queued accesses to the same device in a single bus session
+// 2020-05-03 by Rafael Carbonell <racarla96@gmail.com>
+//
+// Changelog:
+//      2020-05-?? - initial release
+
+/* ============================================
+SPIdev device library code 
+
+MIT License
+
+Copyright (c) 2020 racarla96
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================
+*/
+
+#ifndef _SPIDEVQUEUE_H_
+#define _SPIDEVQUEUE_H_
+
+#include "SPIdev.h"
+
+// Maximum number of accesses waiting in a SPIdevQueue (up to 16)
+#define SPIDEV_QUEUE_LENGTH     16
+
+/*
+    Called once an access has run, with its result: the number of bytes
+    read or written (up to 255), -1 on failure.
+*/
+typedef void (*SPIdevQueueCallback)(void *context, int16_t result);
+
+/*
+    Queue of register accesses. flush() runs all the accesses queued for a
+    device in one bus session (a single SPI transaction, the chip select
+    toggled between accesses), so the settings are applied once per device
+    instead of once per access. Accesses to a device keep their order;
+    devices are served in the order of their first queued access. Callbacks
+    are called once the accesses have left the queue, so they may queue or
+    run accesses of their own, or flush again.
+*/
+class SPIdevQueue {
+    public:
+        uint16_t sessions;      // bus sessions opened by flush()
+        uint16_t accesses;      // accesses run by flush()
+
+        SPIdevQueue();
+
+        bool read(SPIdev *dev, uint8_t regAddr, uint8_t length, uint8_t *data, SPIdevQueueCallback callback = NULL, void *context = NULL);
+        bool write(SPIdev *dev, uint8_t regAddr, uint8_t length, uint8_t *data, SPIdevQueueCallback callback = NULL, void *context = NULL);
+        uint8_t pending();
+        uint8_t flush();
+
+    private:
+        struct Access {
+            SPIdev *dev;
+            uint8_t *data;
+            SPIdevQueueCallback callback;
+            void *context;
+            uint8_t regAddr;
+            uint8_t length;
+            bool write;
+            int16_t result;
+        };
+
+        Access queue[SPIDEV_QUEUE_LENGTH];
+        uint8_t count;
+
+        bool add(SPIdev *dev, uint8_t regAddr, uint8_t length, uint8_t *data, bool write, SPIdevQueueCallback callback, void *context);
+};
+
+#endif
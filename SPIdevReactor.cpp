@@ -0,0 +1,234 @@
+// SPIdev library collection - Event loop
+// Single loop dispatching timers, pin events and device service calls
+// 2020-05-03 by Rafael Carbonell <racarla96@gmail.com>
+//
+// Changelog:
+//      2020-05-?? - initial release
+
+/* ============================================
+SPIdev device library code 
+
+MIT License
+
+Copyright (c) 2020 racarla96
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================
+*/
+
+#include "SPIdevReactor.h"
+
+/** Default constructor.
+ */
+SPIdevReactor::SPIdevReactor() {
+    memset(timers, 0, sizeof(timers));
+    pinCount = 0;
+    sourceCount = 0;
+    taskHead = 0;
+    taskTail = 0;
+    busyPasses = 0;
+}
+
+/** Call a handler periodically.
+ * @param interval Period in milliseconds, the first call is one period from now
+ * @param handler Function to call
+ * @param context Pointer passed to the handler
+ * @return Timer number, to cancel it with (-1 = too many timers)
+ */
+int8_t SPIdevReactor::every(uint32_t interval, SPIdevTimerHandler handler, void *context) {
+    return addTimer(interval, max(interval, (uint32_t) 1), handler, context);
+}
+
+/** Call a handler once.
+ * @param delay Time from now in milliseconds
+ * @param handler Function to call
+ * @param context Pointer passed to the handler
+ * @return Timer number, to cancel it with (-1 = too many timers)
+ */
+int8_t SPIdevReactor::after(uint32_t delay, SPIdevTimerHandler handler, void *context) {
+    return addTimer(delay, 0, handler, context);
+}
+
+/** Stop a timer, it may be called from its own handler.
+ * @param timer Timer number returned by every() or after()
+ */
+void SPIdevReactor::cancel(int8_t timer) {
+    if (timer < 0 || timer >= SPIDEV_REACTOR_MAX_TIMERS) return;
+    timers[timer].handler = NULL;
+}
+
+/** Call a handler on the edges of a pin.
+ * @param pin Pin to watch, its mode is left as it is
+ * @param mode Edges to report: RISING, FALLING or CHANGE
+ * @param handler Function to call
+ * @param context Pointer passed to the handler
+ * @return Status of operation (true = success)
+ */
+bool SPIdevReactor::onPin(uint8_t pin, uint8_t mode, SPIdevPinHandler handler, void *context) {
+    if (pinCount >= SPIDEV_REACTOR_MAX_PINS) return false;
+    Pin &p = pins[pinCount++];
+    p.pin = pin;
+    p.mode = mode;
+    p.handler = handler;
+    p.context = context;
+    p.level = digitalRead(pin);
+    return true;
+}
+
+/** Poll a function on every pass.
+ * @param handler Function to poll, returning true when it did some work
+ * @param context Pointer passed to the handler
+ * @return Status of operation (true = success)
+ */
+bool SPIdevReactor::addSource(SPIdevSourceHandler handler, void *context) {
+    if (sourceCount >= SPIDEV_REACTOR_MAX_SOURCES) return false;
+    sources[sourceCount].handler = handler;
+    sources[sourceCount].context = context;
+    sourceCount++;
+    return true;
+}
+
+/** Drain the FIFOs of a scheduler when they are due.
+ */
+bool SPIdevReactor::addSource(SPIdevFifoScheduler *scheduler) {
+    return addSource(serviceScheduler, scheduler);
+}
+
+/** Poll the registers of a watcher at its own interval.
+ */
+bool SPIdevReactor::addSource(SPIdevWatcher *watcher) {
+    return addSource(serviceWatcher, watcher);
+}
+
+/** Dispatch a shared interrupt line while it is asserted.
+ */
+bool SPIdevReactor::addSource(SPIdevIrqLine *line) {
+    return addSource(serviceIrqLine, line);
+}
+
+/** Run a task once the loop has no I/O to do. May be called from an
+ * interrupt, e.g. when a block of samples is complete.
+ * @param task Function to run
+ * @param context Pointer passed to the task
+ * @return Status of operation (true = success, false = too many tasks pending)
+ */
+bool SPIdevReactor::defer(SPIdevTask task, void *context) {
+    // called from interrupt handlers too: on AVR restore the interrupt state
+    // rather than enabling interrupts inside the handler, like csLow() does
+    #ifdef __AVR__
+        uint8_t oldSREG = SREG;
+        cli();
+    #else
+        noInterrupts();
+    #endif
+    uint8_t next = (taskHead + 1) % SPIDEV_REACTOR_MAX_TASKS;
+    bool queued = (next != taskTail);
+    if (queued) {
+        tasks[taskHead].task = task;
+        tasks[taskHead].context = context;
+        taskHead = next;
+    }
+    #ifdef __AVR__
+        SREG = oldSREG;
+    #else
+        interrupts();
+    #endif
+    return queued;
+}
+
+/** Run one pass of the loop: pin edges first, then sources, then the timers
+ * that are due, and the oldest deferred task if none of them had any work or
+ * if the last SPIDEV_REACTOR_TASK_PERIOD passes were all busy.
+ * Call it from loop().
+ * @return True if any handler or task was called or any source did some work
+ */
+bool SPIdevReactor::service() {
+    bool busy = false;
+
+    for (uint8_t i = 0; i < pinCount; i++) {
+        Pin &p = pins[i];
+        uint8_t level = digitalRead(p.pin);
+        if (level == p.level) continue;
+        p.level = level;
+        if (p.mode == CHANGE || (p.mode == RISING) == (level == HIGH)) {
+            p.handler(p.context, p.pin, level);
+            busy = true;
+        }
+    }
+
+    for (uint8_t i = 0; i < sourceCount; i++) {
+        if (sources[i].handler(sources[i].context)) busy = true;
+    }
+
+    uint32_t now = millis();
+    for (uint8_t i = 0; i < SPIDEV_REACTOR_MAX_TIMERS; i++) {
+        Timer &t = timers[i];
+        if (t.handler == NULL || (int32_t) (now - t.due) < 0) continue;
+        SPIdevTimerHandler handler = t.handler;
+        if (t.interval > 0) {
+            // keep the period, but skip the periods missed while busy
+            t.due += t.interval;
+            if ((int32_t) (now - t.due) >= 0) t.due = now + t.interval;
+        } else {
+            t.handler = NULL;
+        }
+        handler(t.context);
+        busy = true;
+    }
+
+    if (taskTail != taskHead && (!busy || ++busyPasses >= SPIDEV_REACTOR_TASK_PERIOD)) {
+        busyPasses = 0;
+        noInterrupts();
+        Task t = tasks[taskTail];
+        taskTail = (taskTail + 1) % SPIDEV_REACTOR_MAX_TASKS;
+        interrupts();
+        t.task(t.context);
+        busy = true;
+    }
+
+    return busy;
+}
+
+/** Start a timer in the first free slot.
+ * @return Timer number (-1 = too many timers)
+ */
+int8_t SPIdevReactor::addTimer(uint32_t delay, uint32_t interval, SPIdevTimerHandler handler, void *context) {
+    for (uint8_t i = 0; i < SPIDEV_REACTOR_MAX_TIMERS; i++) {
+        Timer &t = timers[i];
+        if (t.handler != NULL) continue;
+        t.handler = handler;
+        t.context = context;
+        t.due = millis() + delay;
+        t.interval = interval;
+        return i;
+    }
+    return -1;
+}
+
+bool SPIdevReactor::serviceScheduler(void *context) {
+    return ((SPIdevFifoScheduler *) context)->service() > 0;
+}
+
+bool SPIdevReactor::serviceWatcher(void *context) {
+    return ((SPIdevWatcher *) context)->service();
+}
+
+bool SPIdevReactor::serviceIrqLine(void *context) {
+    return ((SPIdevIrqLine *) context)->service();
+}
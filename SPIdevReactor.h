@@ -0,0 +1,149 @@
+// SPIdev library collection - Event loop header file
+// Single loop dispatching timers, pin events and device service calls
+// 2020-05-03 by Rafael Carbonell <racarla96@gmail.com>
+//
+// Changelog:
+//      2020-05-?? - initial release
+
+/* ============================================
+SPIdev device library code 
+
+MIT License
+
+Copyright (c) 2020 racarla96
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================
+*/
+
+#ifndef _SPIDEVREACTOR_H_
+#define _SPIDEVREACTOR_H_
+
+#include "SPIdev.h"
+#include "SPIdevFifo.h"
+#include "SPIdevWatcher.h"
+#include "SPIdevIrq.h"
+
+// Maximum number of timers, pins and sources of a SPIdevReactor, and size of
+// its deferred task ring (up to SPIDEV_REACTOR_MAX_TASKS - 1 pending tasks)
+#define SPIDEV_REACTOR_MAX_TIMERS   8
+#define SPIDEV_REACTOR_MAX_PINS     4
+#define SPIDEV_REACTOR_MAX_SOURCES  8
+#define SPIDEV_REACTOR_MAX_TASKS    8
+
+// Number of busy passes in a row after which a deferred task runs anyway, so
+// a source that always has work cannot starve the tasks
+#define SPIDEV_REACTOR_TASK_PERIOD  8
+
+/*
+    Called when a timer expires.
+*/
+typedef void (*SPIdevTimerHandler)(void *context);
+
+/*
+    Called on an edge of a watched pin, with the new level of the pin.
+*/
+typedef void (*SPIdevPinHandler)(void *context, uint8_t pin, uint8_t level);
+
+/*
+    Polled on every pass of the loop, returns true when it did some work.
+*/
+typedef bool (*SPIdevSourceHandler)(void *context);
+
+/*
+    Deferred processing task, e.g. decoding or filtering a block of samples.
+*/
+typedef void (*SPIdevTask)(void *context);
+
+/*
+    Cooperative event loop: every service() call is one pass over the watched
+    pins, the sources and the timers, all handlers run to completion in the
+    caller's context, one at a time. Pins are sampled on every pass, so
+    pulses shorter than a pass must be latched in an interrupt and exposed as
+    a source. FIFO schedulers, register watchers and shared interrupt lines
+    are added as sources, so one loop drives every acquisition.
+    Processing that is not I/O is deferred as tasks: a task runs on a pass
+    where no pin, source or timer had any work, one task per pass in the
+    order they were deferred, so processing rarely delays a drain. While the
+    I/O stays busy, one task still runs every SPIDEV_REACTOR_TASK_PERIOD
+    passes.
+*/
+class SPIdevReactor {
+    public:
+        SPIdevReactor();
+
+        int8_t every(uint32_t interval, SPIdevTimerHandler handler, void *context = NULL);
+        int8_t after(uint32_t delay, SPIdevTimerHandler handler, void *context = NULL);
+        void cancel(int8_t timer);
+
+        bool onPin(uint8_t pin, uint8_t mode, SPIdevPinHandler handler, void *context = NULL);
+
+        bool addSource(SPIdevSourceHandler handler, void *context = NULL);
+        bool addSource(SPIdevFifoScheduler *scheduler);
+        bool addSource(SPIdevWatcher *watcher);
+        bool addSource(SPIdevIrqLine *line);
+
+        bool defer(SPIdevTask task, void *context = NULL);
+
+        bool service();
+
+    private:
+        struct Timer {
+            SPIdevTimerHandler handler;
+            void *context;
+            uint32_t due;
+            uint32_t interval;      // 0 = one-shot
+        };
+
+        struct Pin {
+            SPIdevPinHandler handler;
+            void *context;
+            uint8_t pin;
+            uint8_t mode;           // RISING, FALLING or CHANGE
+            uint8_t level;
+        };
+
+        struct Source {
+            SPIdevSourceHandler handler;
+            void *context;
+        };
+
+        struct Task {
+            SPIdevTask task;
+            void *context;
+        };
+
+        Timer timers[SPIDEV_REACTOR_MAX_TIMERS];
+        Pin pins[SPIDEV_REACTOR_MAX_PINS];
+        Source sources[SPIDEV_REACTOR_MAX_SOURCES];
+        Task tasks[SPIDEV_REACTOR_MAX_TASKS];
+        uint8_t pinCount;
+        uint8_t sourceCount;
+        volatile uint8_t taskHead;
+        volatile uint8_t taskTail;
+        uint8_t busyPasses;     // busy passes in a row with a task pending
+
+        int8_t addTimer(uint32_t delay, uint32_t interval, SPIdevTimerHandler handler, void *context);
+
+        static bool serviceScheduler(void *context);
+        static bool serviceWatcher(void *context);
+        static bool serviceIrqLine(void *context);
+};
+
+#endif
@@ -0,0 +1,105 @@
+// SPIdev library collection - Pipelined ADC channel scanner
+// Scans a list of ADC channels in one transaction of pipelined frames
+// 2020-05-03 by Rafael Carbonell <racarla96@gmail.com>
+//
+// Changelog:
+//      2020-05-?? - initial release
+
+/* ============================================
+SPIdev device library code 
+
+MIT License
+
+Copyright (c) 2020 racarla96
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================
+*/
+
+#include "SPIdevScan.h"
+
+/** Default constructor.
+ * @param dev Device of the ADC
+ * @param frameSize Number of bytes per frame (up to SPIDEV_SCAN_MAX_FRAME)
+ * @param latency Frames between the command for a channel and its result (up to SPIDEV_SCAN_MAX_LATENCY)
+ */
+SPIdevScan::SPIdevScan(SPIdev *dev, uint8_t frameSize, uint8_t latency) {
+    this->dev = dev;
+    this->frameSize = constrain(frameSize, (uint8_t) 2, (uint8_t) SPIDEV_SCAN_MAX_FRAME);
+    this->latency = min(latency, (uint8_t) SPIDEV_SCAN_MAX_LATENCY);
+    count = 0;
+    mask = 0xFFFF;
+    shift = 0;
+    gapMicros = 0;
+}
+
+/** Compile a scan list into the plan of command frames.
+ * The frames after the last channel, which only collect the pending results,
+ * repeat the command for the last channel.
+ * @param channels Channels to scan, in order (the same channel may appear more than once)
+ * @param count Number of channels (up to SPIDEV_SCAN_MAX_CHANNELS)
+ * @param command Function building the command frame of a channel
+ * @return Status of operation (true = success)
+ */
+bool SPIdevScan::setChannels(const uint8_t *channels, uint8_t count, SPIdevScanCommand command) {
+    if (count == 0 || count > SPIDEV_SCAN_MAX_CHANNELS) return false;
+
+    memset(plan, 0, sizeof(plan));
+    for (uint8_t n = 0; n < count + latency; n++) {
+        command(channels[min(n, (uint8_t) (count - 1))], &plan[n * frameSize]);
+    }
+    this->count = count;
+    return true;
+}
+
+/** Set where the result sits in the last two bytes of a frame.
+ * @param mask Mask applied to the result once shifted
+ * @param shift Number of bits the result is shifted right by
+ */
+void SPIdevScan::setResultFormat(uint16_t mask, uint8_t shift) {
+    this->mask = mask;
+    this->shift = shift;
+}
+
+/** Set the time the chip select is held high between frames.
+ * @param gapMicros Time in microseconds (0 = as short as possible)
+ */
+void SPIdevScan::setGap(uint16_t gapMicros) {
+    this->gapMicros = gapMicros;
+}
+
+/** Run the plan in one transaction and collect a result per channel.
+ * @param results Buffer to store the results in, in scan list order
+ * @return Number of results read (-1 indicates no scan list or failure)
+ */
+int8_t SPIdevScan::scan(uint16_t *results) {
+    if (count == 0) return -1;
+
+    uint8_t n = count + latency;
+    memcpy(frames, plan, (size_t) n * frameSize);
+    if (!dev->transferFrames(frames, frameSize, n, gapMicros)) return -1;
+
+    // the result of channel i comes back latency frames after its command
+    const uint8_t *frame = &frames[latency * frameSize + frameSize - 2];
+    for (uint8_t i = 0; i < count; i++) {
+        results[i] = (((uint16_t) frame[0] << 8 | frame[1]) >> shift) & mask;
+        frame += frameSize;
+    }
+    return count;
+}
@@ -0,0 +1,83 @@
+// SPIdev library collection - Pipelined ADC channel scanner header file
+// Scans a list of ADC channels in one transaction of pipelined frames
+// 2020-05-03 by Rafael Carbonell <racarla96@gmail.com>
+//
+// Changelog:
+//      2020-05-?? - initial release
+
+/* ============================================
+SPIdev device library code 
+
+MIT License
+
+Copyright (c) 2020 racarla96
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================
+*/
+
+#ifndef _SPIDEVSCAN_H_
+#define _SPIDEVSCAN_H_
+
+#include "SPIdev.h"
+
+// Maximum number of channels in a scan list, bytes per frame and pipeline depth
+#define SPIDEV_SCAN_MAX_CHANNELS    16
+#define SPIDEV_SCAN_MAX_FRAME       3
+#define SPIDEV_SCAN_MAX_LATENCY     2
+
+#define SPIDEV_SCAN_PLAN_SIZE       ((SPIDEV_SCAN_MAX_CHANNELS + SPIDEV_SCAN_MAX_LATENCY) * SPIDEV_SCAN_MAX_FRAME)
+
+/*
+    Fills the command frame that selects a channel.
+*/
+typedef void (*SPIdevScanCommand)(uint8_t channel, uint8_t *frame);
+
+/*
+    Scanner for multiplexed ADCs whose conversions are pipelined: the frame
+    that sends the command for a channel also returns the result of the
+    channel commanded latency frames before. The scan list is compiled once
+    into a plan of command frames, then every scan runs the whole plan in a
+    single transaction, so all the frames but the last latency ones carry a
+    result. Results are read big-endian from the last two bytes of each
+    frame, then shifted and masked (e.g. mask 0x0FFF for a 12-bit result
+    tagged with its channel in the upper bits).
+*/
+class SPIdevScan {
+    public:
+        SPIdevScan(SPIdev *dev, uint8_t frameSize = 2, uint8_t latency = 1);
+
+        bool setChannels(const uint8_t *channels, uint8_t count, SPIdevScanCommand command);
+        void setResultFormat(uint16_t mask, uint8_t shift = 0);
+        void setGap(uint16_t gapMicros);
+        int8_t scan(uint16_t *results);
+
+    private:
+        SPIdev *dev;
+        uint8_t frameSize;
+        uint8_t latency;
+        uint8_t count;
+        uint8_t shift;
+        uint16_t mask;
+        uint16_t gapMicros;
+        uint8_t plan[SPIDEV_SCAN_PLAN_SIZE];    // command frames
+        uint8_t frames[SPIDEV_SCAN_PLAN_SIZE];  // frames exchanged by the last scan
+};
+
+#endif
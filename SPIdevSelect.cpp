@@ -0,0 +1,181 @@
+// SPIdev library collection - Chip-select strategies
+// Selects devices through decoders, shift registers or shared ports
+// 2020-05-03 by Rafael Carbonell <racarla96@gmail.com>
+//
+// Changelog:
+//      2020-05-?? - initial release
+
+/* ============================================
+SPIdev device library code 
+
+MIT License
+
+Copyright (c) 2020 racarla96
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================
+*/
+
+#include "SPIdevSelect.h"
+
+/** Default constructor.
+ * @param addressPins Pins wired to the address lines, least significant first
+ * @param bits Number of address lines (up to SPIDEV_DECODER_MAX_BITS)
+ * @param enablePin Pin wired to the active-low enable line
+ */
+SPIdevDecoderSelect::SPIdevDecoderSelect(const uint8_t *addressPins, uint8_t bits, uint8_t enablePin) {
+    this->bits = min(bits, (uint8_t) SPIDEV_DECODER_MAX_BITS);
+    this->enablePin = enablePin;
+    memcpy(this->addressPins, addressPins, this->bits);
+
+    digitalWrite(enablePin, HIGH);
+    pinMode(enablePin, OUTPUT);
+    for (uint8_t b = 0; b < this->bits; b++) {
+        digitalWrite(this->addressPins[b], LOW);
+        pinMode(this->addressPins[b], OUTPUT);
+    }
+    lastAddress = 0;
+}
+
+/** Assert the decoder output of a device.
+ * @param address Decoder output the device is wired to
+ */
+void SPIdevDecoderSelect::select(uint8_t address) {
+    uint8_t changed = address ^ lastAddress;
+    if (changed) {
+        for (uint8_t b = 0; b < bits; b++) {
+            if (changed & (1 << b)) digitalWrite(addressPins[b], (address >> b) & 1);
+        }
+        lastAddress = address;
+    }
+    digitalWrite(enablePin, LOW);
+}
+
+/** Release the decoder output, the address lines are left as they are.
+ */
+void SPIdevDecoderSelect::deselect(uint8_t /*address*/) {
+    digitalWrite(enablePin, HIGH);
+}
+
+/** Default constructor.
+ * @param dataPin Pin wired to the serial input of the first register
+ * @param clockPin Pin wired to the shift clock of the registers
+ * @param latchPin Pin wired to the storage (latch) clock of the registers
+ * @param registers Number of registers in the chain (up to SPIDEV_SHIFT_MAX_REGISTERS)
+ */
+SPIdevShiftSelect::SPIdevShiftSelect(uint8_t dataPin, uint8_t clockPin, uint8_t latchPin, uint8_t registers) {
+    this->dataPin = dataPin;
+    this->clockPin = clockPin;
+    this->latchPin = latchPin;
+    this->registers = min(registers, (uint8_t) SPIDEV_SHIFT_MAX_REGISTERS);
+
+    pinMode(dataPin, OUTPUT);
+    pinMode(clockPin, OUTPUT);
+    digitalWrite(latchPin, LOW);
+    pinMode(latchPin, OUTPUT);
+    // start with every chip-select line high
+    write(0xFF);
+}
+
+/** Drive the chip-select line of a device low, all the others high.
+ * @param address Register output the device is wired to, 8 per register
+ */
+void SPIdevShiftSelect::select(uint8_t address) {
+    write(address);
+}
+
+/** Drive every chip-select line high.
+ */
+void SPIdevShiftSelect::deselect(uint8_t /*address*/) {
+    write(0xFF);
+}
+
+/** Shift out and latch the chip-select lines.
+ * @param address Output to drive low, the others are driven high (0xFF = none)
+ */
+void SPIdevShiftSelect::write(uint8_t address) {
+    // the last register of the chain is shifted out first
+    for (uint8_t r = registers; r-- > 0; ) {
+        uint8_t lines = 0xFF;
+        if ((address >> 3) == r) lines &= ~(1 << (address & 7));
+        shiftOut(dataPin, clockPin, MSBFIRST, lines);
+    }
+    digitalWrite(latchPin, HIGH);
+    digitalWrite(latchPin, LOW);
+}
+
+/** Default constructor.
+ * @param pins Chip-select pins, on the same port for single-write selects on AVR
+ * @param count Number of pins (up to SPIDEV_PORT_MAX_PINS)
+ */
+SPIdevPortSelect::SPIdevPortSelect(const uint8_t *pins, uint8_t count) {
+    this->count = min(count, (uint8_t) SPIDEV_PORT_MAX_PINS);
+    memcpy(this->pins, pins, this->count);
+
+    #ifdef __AVR__
+        port = (this->count > 0) ? digitalPinToPort(pins[0]) : NOT_A_PORT;
+        all = 0;
+    #endif
+    for (uint8_t i = 0; i < this->count; i++) {
+        digitalWrite(this->pins[i], HIGH);
+        pinMode(this->pins[i], OUTPUT);
+        #ifdef __AVR__
+            // a pin on another port rules out the single port write
+            if (digitalPinToPort(this->pins[i]) != port) port = NOT_A_PORT;
+            masks[i] = digitalPinToBitMask(this->pins[i]);
+            all |= masks[i];
+        #endif
+    }
+}
+
+/** Assert the pin of a device and release the others.
+ * @param address Index of the pin of the device
+ */
+void SPIdevPortSelect::select(uint8_t address) {
+    if (address >= count) return;
+    #ifdef __AVR__
+        if (port != NOT_A_PORT) {
+            volatile uint8_t *out = portOutputRegister(port);
+            uint8_t oldSREG = SREG;
+            cli();
+            *out = (*out | all) & ~masks[address];
+            SREG = oldSREG;
+            return;
+        }
+    #endif
+    digitalWrite(pins[address], LOW);
+}
+
+/** Release the pin of a device.
+ * @param address Index of the pin of the device
+ */
+void SPIdevPortSelect::deselect(uint8_t address) {
+    if (address >= count) return;
+    #ifdef __AVR__
+        if (port != NOT_A_PORT) {
+            volatile uint8_t *out = portOutputRegister(port);
+            uint8_t oldSREG = SREG;
+            cli();
+            *out |= all;
+            SREG = oldSREG;
+            return;
+        }
+    #endif
+    digitalWrite(pins[address], HIGH);
+}
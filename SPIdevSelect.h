@@ -0,0 +1,134 @@
+// SPIdev library collection - Chip-select strategies header file
+// Selects devices through decoders, shift registers or shared ports
+// 2020-05-03 by Rafael Carbonell <racarla96@gmail.com>
+//
+// Changelog:
+//      2020-05-?? - initial release
+
+/* ============================================
+SPIdev device library code 
+
+MIT License
+
+Copyright (c) 2020 racarla96
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================
+*/
+
+#ifndef _SPIDEVSELECT_H_
+#define _SPIDEVSELECT_H_
+
+#include "Arduino.h"
+
+// Maximum number of address lines of a SPIdevDecoderSelect (64 devices)
+#define SPIDEV_DECODER_MAX_BITS     6
+
+// Maximum number of registers in the chain of a SPIdevShiftSelect (64 devices)
+#define SPIDEV_SHIFT_MAX_REGISTERS  8
+
+// Maximum number of chip-select pins of a SPIdevPortSelect
+#define SPIDEV_PORT_MAX_PINS        8
+
+/*
+    Chip-select strategy for devices that do not have an MCU pin of their own.
+    A device built on a strategy passes its address to select() at the start
+    of every transaction and to deselect() at the end of it, once accepts()
+    has approved that address. Devices built on a slave pin do not go through
+    this interface at all.
+*/
+class SPIdevSelect {
+    public:
+        virtual void select(uint8_t address) = 0;
+        virtual void deselect(uint8_t address) = 0;
+        virtual bool accepts(uint8_t /*address*/) { return true; }
+};
+
+/*
+    Binary decoder (e.g. a 74HC138 for 3 address lines, two of them sharing
+    the fourth line on their enables for 4, larger cascades for up to 6):
+    the address lines pick the output and the active-low enable line asserts
+    it. The last address is kept, so consecutive accesses to the same device
+    only toggle the enable line, and switching devices only re-drives the
+    address lines that change.
+*/
+class SPIdevDecoderSelect : public SPIdevSelect {
+    public:
+        SPIdevDecoderSelect(const uint8_t *addressPins, uint8_t bits, uint8_t enablePin);
+
+        void select(uint8_t address);
+        void deselect(uint8_t address);
+        bool accepts(uint8_t address) { return address < (1 << bits); }
+
+    private:
+        uint8_t addressPins[SPIDEV_DECODER_MAX_BITS];
+        uint8_t bits;
+        uint8_t enablePin;
+        uint8_t lastAddress;
+};
+
+/*
+    Chain of serial-in, parallel-out shift registers (e.g. 74HC595) whose
+    outputs drive the chip-select lines, 8 devices per register. Every select
+    and deselect shifts the whole chain out and latches it, so this is the
+    slowest strategy; it needs 3 pins for any number of devices.
+*/
+class SPIdevShiftSelect : public SPIdevSelect {
+    public:
+        SPIdevShiftSelect(uint8_t dataPin, uint8_t clockPin, uint8_t latchPin, uint8_t registers = 1);
+
+        void select(uint8_t address);
+        void deselect(uint8_t address);
+        bool accepts(uint8_t address) { return address < registers * 8; }
+
+    private:
+        uint8_t dataPin;
+        uint8_t clockPin;
+        uint8_t latchPin;
+        uint8_t registers;
+
+        void write(uint8_t address);
+};
+
+/*
+    Chip-select pins that all belong to the same port. The address is the
+    index of the pin in the list; on AVR a select drives the whole group in a
+    single port write, asserting that pin and releasing all the others, so no
+    two devices of the group can ever be selected at once. Pins spread over
+    several ports are driven one at a time with digitalWrite instead.
+*/
+class SPIdevPortSelect : public SPIdevSelect {
+    public:
+        SPIdevPortSelect(const uint8_t *pins, uint8_t count);
+
+        void select(uint8_t address);
+        void deselect(uint8_t address);
+        bool accepts(uint8_t address) { return address < count; }
+
+    private:
+        uint8_t pins[SPIDEV_PORT_MAX_PINS];
+        uint8_t count;
+        #ifdef __AVR__
+            uint8_t port;       // NOT_A_PORT if the pins are on several ports
+            uint8_t masks[SPIDEV_PORT_MAX_PINS];
+            uint8_t all;
+        #endif
+};
+
+#endif
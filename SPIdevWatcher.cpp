@@ -0,0 +1,195 @@
+// SPIdev library collection - Register watcher
+// Polls status registers of many devices in batches and reports changes
+// 2020-05-03 by Rafael Carbonell <racarla96@gmail.com>
+//
+// Changelog:
+//      2020-05-?? - initial release
+
+/* ============================================
+SPIdev device library code 
+
+MIT License
+
+Copyright (c) 2020 racarla96
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================
+*/
+
+#include "SPIdevWatcher.h"
+
+/** Default constructor.
+ * @param minInterval Poll interval after a change, in milliseconds
+ * @param maxInterval Poll interval when nothing changes, in milliseconds
+ *        (equal to minInterval for a fixed rate)
+ */
+SPIdevWatcher::SPIdevWatcher(uint32_t minInterval, uint32_t maxInterval) {
+    this->minInterval = minInterval;
+    this->maxInterval = max(minInterval, maxInterval);
+    interval = minInterval;
+    lastPoll = 0;
+    count = 0;
+    polling = false;
+    removed = 0;
+    maxSpan = SPIDEV_WATCHER_DEFAULT_SPAN;
+}
+
+/** Watch bits of a register.
+ * The first poll only records the current value, handlers are called from
+ * the second one on.
+ * @param dev Device to watch
+ * @param regAddr Register to watch
+ * @param mask Bits of the register to watch
+ * @param handler Function called when a watched bit changes
+ * @param context Pointer passed back to the handler
+ * @return Status of operation (false = too many subscriptions)
+ */
+bool SPIdevWatcher::subscribe(SPIdev *dev, uint8_t regAddr, uint8_t mask, SPIdevWatchHandler handler, void *context) {
+    if (count >= SPIDEV_WATCHER_MAX_SUBSCRIPTIONS) return false;
+    Subscription &s = subscriptions[count++];
+    s.dev = dev;
+    s.regAddr = regAddr;
+    s.mask = mask;
+    s.handler = handler;
+    s.context = context;
+    s.primed = false;
+    return true;
+}
+
+/** Stop watching a register.
+ * May be called from a handler: the subscription is then no longer reported
+ * and is removed once the poll is over.
+ * @param dev Device watched
+ * @param regAddr Register watched
+ * @param handler Handler given to subscribe
+ */
+void SPIdevWatcher::unsubscribe(SPIdev *dev, uint8_t regAddr, SPIdevWatchHandler handler) {
+    for (uint8_t i = 0; i < count; i++) {
+        Subscription &s = subscriptions[i];
+        if (removed & (1 << i)) continue;
+        if (s.dev == dev && s.regAddr == regAddr && s.handler == handler) {
+            if (polling) {
+                removed |= 1 << i;
+            } else {
+                subscriptions[i] = subscriptions[--count];
+            }
+            return;
+        }
+    }
+}
+
+/** Set the widest register range read in a single burst.
+ * Devices whose subscribed registers spread wider are read one register at
+ * a time. 1 disables the batching.
+ * @param registers Number of consecutive registers (1-SPIDEV_WATCHER_MAX_SPAN)
+ */
+void SPIdevWatcher::setMaxSpan(uint8_t registers) {
+    maxSpan = constrain(registers, (uint8_t) 1, (uint8_t) SPIDEV_WATCHER_MAX_SPAN);
+}
+
+/** Poll if the current interval has elapsed, call it from loop().
+ * @return True if a poll was done
+ */
+bool SPIdevWatcher::service() {
+    uint32_t now = millis();
+    if (now - lastPoll < interval) return false;
+    lastPoll = now;
+    poll();
+    return true;
+}
+
+/** Read every subscribed register now and report the changes.
+ * Subscriptions of a device whose read fails are skipped for this poll.
+ * @return Number of handlers called
+ */
+uint8_t SPIdevWatcher::poll() {
+    uint8_t fired = 0;
+    uint8_t buffer[SPIDEV_WATCHER_MAX_SPAN];
+    // subscriptions already read during this poll, one bit each
+    uint16_t done = 0;
+    polling = true;
+
+    for (uint8_t i = 0; i < count; i++) {
+        if (done & (1 << i)) continue;
+        SPIdev *dev = subscriptions[i].dev;
+
+        // register range subscribed on this device
+        uint8_t first = subscriptions[i].regAddr;
+        uint8_t last = first;
+        for (uint8_t j = i + 1; j < count; j++) {
+            if (subscriptions[j].dev != dev) continue;
+            first = min(first, subscriptions[j].regAddr);
+            last = max(last, subscriptions[j].regAddr);
+        }
+
+        bool batch = (uint8_t) (last - first) < maxSpan;
+        // a failed read leaves the remaining subscriptions of the device
+        // unreported until the next poll
+        bool failed = batch && dev->readBytes(first, last - first + 1, buffer) < 0;
+
+        for (uint8_t j = i; j < count; j++) {
+            Subscription &s = subscriptions[j];
+            if (s.dev != dev) continue;
+            done |= 1 << j;
+            if (failed || (removed & (1 << j))) continue;
+            uint8_t value;
+            if (batch) {
+                value = buffer[s.regAddr - first];
+            } else {
+                // a register subscribed more than once is only read once
+                uint8_t k;
+                for (k = i; k < j; k++) {
+                    Subscription &t = subscriptions[k];
+                    if (t.dev == dev && t.regAddr == s.regAddr && !(removed & (1 << k))) break;
+                }
+                if (k < j) {
+                    value = subscriptions[k].value;
+                } else if (dev->readByte(s.regAddr, &value) < 0) {
+                    failed = true;
+                    continue;
+                }
+            }
+            fired += update(s, value);
+        }
+    }
+
+    // drop the subscriptions removed by the handlers, last first so that the
+    // one moved into a free slot has already been checked
+    polling = false;
+    for (uint8_t i = count; i-- > 0; ) {
+        if (removed & (1 << i)) subscriptions[i] = subscriptions[--count];
+    }
+    removed = 0;
+
+    interval = (fired > 0) ? minInterval : min(interval * 2, maxInterval);
+    return fired;
+}
+
+/** Record a new reading and call the handler if a watched bit changed.
+ * @return 1 if the handler was called, 0 otherwise
+ */
+uint8_t SPIdevWatcher::update(Subscription &s, uint8_t value) {
+    uint8_t previous = s.value;
+    bool primed = s.primed;
+    s.value = value;
+    s.primed = true;
+    if (!primed || ((value ^ previous) & s.mask) == 0) return 0;
+    s.handler(s.context, s.dev, s.regAddr, value, previous);
+    return 1;
+}
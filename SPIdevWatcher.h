@@ -0,0 +1,96 @@
+// SPIdev library collection - Register watcher header file
+// Polls status registers of many devices in batches and reports changes
+// 2020-05-03 by Rafael Carbonell <racarla96@gmail.com>
+//
+// Changelog:
+//      2020-05-?? - initial release
+
+/* ============================================
+SPIdev device library code 
+
+MIT License
+
+Copyright (c) 2020 racarla96
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================
+*/
+
+#ifndef _SPIDEVWATCHER_H_
+#define _SPIDEVWATCHER_H_
+
+#include "SPIdev.h"
+
+// Maximum number of subscriptions of a SPIdevWatcher (up to 16)
+#define SPIDEV_WATCHER_MAX_SUBSCRIPTIONS    16
+// Widest register range read in one burst, and its default (see setMaxSpan)
+#define SPIDEV_WATCHER_MAX_SPAN             32
+#define SPIDEV_WATCHER_DEFAULT_SPAN         8
+
+/*
+    Called when a masked bit of a watched register changes.
+*/
+typedef void (*SPIdevWatchHandler)(void *context, SPIdev *dev, uint8_t regAddr, uint8_t value, uint8_t previous);
+
+/*
+    Watches (device, register, mask) subscriptions. Each poll reads all the
+    registers subscribed on a device in a single burst, from the lowest to the
+    highest one, and calls the handlers whose masked bits changed.
+    Registers in between are read too: lower the span (setMaxSpan) if one of
+    them is cleared on read. Otherwise each register is read once per poll,
+    however many subscriptions it has. The poll interval is adaptive: it drops to the
+    minimum when something changed and doubles up to the maximum while nothing
+    does.
+*/
+class SPIdevWatcher {
+    public:
+        SPIdevWatcher(uint32_t minInterval, uint32_t maxInterval);
+
+        bool subscribe(SPIdev *dev, uint8_t regAddr, uint8_t mask, SPIdevWatchHandler handler, void *context = NULL);
+        void unsubscribe(SPIdev *dev, uint8_t regAddr, SPIdevWatchHandler handler);
+        void setMaxSpan(uint8_t registers);
+
+        bool service();
+        uint8_t poll();
+
+    private:
+        struct Subscription {
+            SPIdev *dev;
+            SPIdevWatchHandler handler;
+            void *context;
+            uint8_t regAddr;
+            uint8_t mask;
+            uint8_t value;
+            bool primed;    // value holds a reading
+        };
+
+        Subscription subscriptions[SPIDEV_WATCHER_MAX_SUBSCRIPTIONS];
+        uint8_t count;
+        bool polling;
+        uint16_t removed;       // subscriptions unsubscribed during the poll, one bit each
+        uint8_t maxSpan;
+        uint32_t minInterval;
+        uint32_t maxInterval;
+        uint32_t interval;
+        uint32_t lastPoll;
+
+        uint8_t update(Subscription &s, uint8_t value);
+};
+
+#endif
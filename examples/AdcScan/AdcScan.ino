@@ -0,0 +1,67 @@
+#include "SPI.h"
+#include "SPIdev.h"
+#include "SPIdevScan.h"
+
+// Scans 8 channels of an ADS7953 (16-bit frames, 12-bit results tagged with
+// their channel) in manual mode, where the result of a command comes back two
+// frames later. The scan runs the whole list in one transaction; the time of
+// the same scan done one channel at a time is printed for comparison.
+
+const uint32_t SPI_HS_CLOCK = 8000000; // 8 MHz
+SPISettings settings(SPI_HS_CLOCK, MSBFIRST, SPI_MODE0);
+SPIdev spidev(10, settings, MSBFIRST);
+
+const uint8_t CHANNELS[] = {0, 1, 2, 3, 4, 5, 6, 7};
+const uint8_t COUNT = sizeof(CHANNELS);
+
+SPIdevScan scanner(&spidev, 2, 2);
+uint16_t results[COUNT];
+
+// manual mode, program the channel (DI11) and select it (DI10-07)
+void manualCommand(uint8_t channel, uint8_t *frame) {
+  uint16_t command = 0x1800 | ((uint16_t) channel << 7);
+  frame[0] = command >> 8;
+  frame[1] = command & 0xFF;
+}
+
+// one channel per scan, with a transaction per frame
+void scanOneByOne() {
+  for (uint8_t i = 0; i < COUNT; i++) {
+    uint8_t frame[2];
+    for (uint8_t n = 0; n < 3; n++) {
+      manualCommand(CHANNELS[i], frame);
+      spidev.transferFrames(frame, 2, 1);
+    }
+    results[i] = ((uint16_t) frame[0] << 8 | frame[1]) & 0x0FFF;
+  }
+}
+
+void setup() {
+  Serial.begin(115200);
+  scanner.setChannels(CHANNELS, COUNT, manualCommand);
+  scanner.setResultFormat(0x0FFF);
+
+  uint32_t start = micros();
+  for (uint8_t i = 0; i < 100; i++) scanOneByOne();
+  Serial.print("one by one: ");
+  Serial.print((micros() - start) / 100);
+  Serial.println(" us/scan");
+
+  start = micros();
+  for (uint8_t i = 0; i < 100; i++) scanner.scan(results);
+  Serial.print("pipelined: ");
+  Serial.print((micros() - start) / 100);
+  Serial.println(" us/scan");
+}
+
+void loop() {
+  if (scanner.scan(results) < 0) {
+    Serial.println("scan failed");
+  } else {
+    for (uint8_t i = 0; i < COUNT; i++) {
+      Serial.print(results[i]);
+      Serial.print(i < COUNT - 1 ? "\t" : "\n");
+    }
+  }
+  delay(100);
+}
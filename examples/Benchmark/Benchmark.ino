@@ -0,0 +1,246 @@
+#include "SPI.h"
+#include "SPIdev.h"
+#include "SPIdevDSP.h"
+#include "SPIdevSelect.h"
+#include "SPIdevQueue.h"
+
+// Benchmark suite for SPIdev: prints the cost of each library path on the
+// serial port, results are in microseconds per call averaged over RUNS calls.
+// Enable SPIDEV_SOFT_LSBFIRST in SPIdev.h to measure the table-driven reversal
+// and SPIDEV_FAULT_INJECTION with SPIDEV_CRC to measure CRC-protected reads on
+// a noisy bus.
+// The sample path runs in Q15 fixed point, or in float with SPIDEV_FLOAT_SAMPLES
+// enabled in SPIdevDSP.h; build it both ways (e.g. under simavr) to compare
+// the cycles per sample. SPIDEV_BUS_STATS adds the bus utilization of the run.
+// The RAM taken by each device is printed first. Chip-select strategies are
+// timed on pins 2-8 and A0-A1, which must be left unconnected or wired to the
+// decoder, shift register and devices they drive.
+
+const uint32_t SPI_HS_CLOCK = 8000000; // 8 MHz
+SPISettings settings(SPI_HS_CLOCK, MSBFIRST, SPI_MODE3);
+SPIdev spidev(10, settings, MSBFIRST);
+
+const uint16_t RUNS = 1000;
+const uint8_t BURST = 32;
+uint8_t buffer[BURST];
+
+// 74HC138 on pins 2-4 (A0-A2) and 5 (G2A), 74HC595 on pins 6-8, CS pins on A0-A1
+const uint8_t DECODER_PINS[] = {2, 3, 4};
+const uint8_t PORT_PINS[] = {A0, A1};
+SPIdevDecoderSelect decoder(DECODER_PINS, 3, 5);
+SPIdevShiftSelect shiftRegister(6, 7, 8);
+SPIdevPortSelect port(PORT_PINS, 2);
+SPIdev decoded0(decoder, 0, settings, MSBFIRST);
+SPIdev decoded1(decoder, 1, settings, MSBFIRST);
+SPIdev shifted(shiftRegister, 0, settings, MSBFIRST);
+SPIdev ported(port, 0, settings, MSBFIRST);
+
+void report(const char *name, uint32_t elapsed) {
+  Serial.print(name);
+  Serial.print(": ");
+  Serial.print((float) elapsed / RUNS, 3);
+  Serial.println(" us");
+}
+
+void benchReverse() {
+  uint32_t start = micros();
+  for (uint16_t i = 0; i < RUNS; i++) {
+    SPIdev::reverseBits(buffer, BURST);
+  }
+  report("reverseBits x32", micros() - start);
+}
+
+void benchCRC() {
+  volatile uint8_t crc = 0;
+  uint32_t start = micros();
+  for (uint16_t i = 0; i < RUNS; i++) {
+    crc = SPIdev::crc8(buffer, BURST, crc);
+  }
+  report("crc8 x32", micros() - start);
+}
+
+void benchSamplePath() {
+  uint16_t raw[BURST / 2];
+  spidev_sample_t samples[BURST / 2];
+  SPIdevLowPass lowPass(SPIDEV_SAMPLE(0.1));
+  memcpy(raw, buffer, sizeof(raw));
+
+  uint32_t start = micros();
+  for (uint16_t i = 0; i < RUNS; i++) {
+    decodeSamples(raw, samples, BURST / 2);
+    scaleSamples(samples, BURST / 2, SPIDEV_SAMPLE(0.5));
+    lowPass.process(samples, BURST / 2);
+  }
+  uint32_t elapsed = micros() - start;
+
+#ifdef SPIDEV_FLOAT_SAMPLES
+  Serial.print("float");
+#else
+  Serial.print("Q15");
+#endif
+  Serial.print(" decode+scale+filter: ");
+  Serial.print((float) elapsed * clockCyclesPerMicrosecond() / ((uint32_t) RUNS * (BURST / 2)), 1);
+  Serial.println(" cycles/sample");
+}
+
+void benchRegister() {
+  uint32_t start = micros();
+  for (uint16_t i = 0; i < RUNS; i++) {
+    spidev.readByte(0x3B, buffer);
+  }
+  report("readByte", micros() - start);
+}
+
+// Single-register reads through each chip-select strategy, to compare with
+// the direct slave pin; alternating decoder addresses re-drive the address lines
+void benchSelect() {
+  SPIdev *devices[] = {&decoded0, &shifted, &ported};
+  const char *names[] = {"readByte decoder", "readByte shift register", "readByte port"};
+  for (uint8_t d = 0; d < 3; d++) {
+    uint32_t start = micros();
+    for (uint16_t i = 0; i < RUNS; i++) {
+      devices[d]->readByte(0x3B, buffer);
+    }
+    report(names[d], micros() - start);
+  }
+
+  uint32_t start = micros();
+  for (uint16_t i = 0; i < RUNS; i++) {
+    ((i & 1) ? decoded1 : decoded0).readByte(0x3B, buffer);
+  }
+  report("readByte decoder, alternating", micros() - start);
+}
+
+void benchWrite() {
+  uint32_t start = micros();
+  for (uint16_t i = 0; i < RUNS; i++) {
+    spidev.writeBytes(0x3B, BURST, buffer);
+  }
+  report("writeBytes x32", micros() - start);
+}
+
+// 8 short reads queued and run in one bus session, against running them one
+// transaction each (results in microseconds per read)
+void benchQueue() {
+  SPIdevQueue queue;
+  uint32_t start = micros();
+  for (uint16_t i = 0; i < RUNS / 8; i++) {
+    for (uint8_t n = 0; n < 8; n++) queue.read(&spidev, 0x3B, 2, buffer + 2 * n);
+    queue.flush();
+  }
+  report("queued readBytes x2", micros() - start);
+
+  start = micros();
+  for (uint16_t i = 0; i < RUNS; i++) {
+    spidev.readBytes(0x3B, 2, buffer);
+  }
+  report("readBytes x2", micros() - start);
+}
+
+// RAM per device: its descriptor, plus one entry of the shared profile table
+// for each distinct SPISettings in use
+void reportFootprint() {
+  Serial.print("SPIdev: ");
+  Serial.print((unsigned int) sizeof(SPIdev));
+  Serial.print(" bytes per device, ");
+  Serial.print(SPIdev::profileCount);
+  Serial.print(" shared profile(s) of ");
+  Serial.print((unsigned int) sizeof(SPISettings));
+  Serial.println(" bytes");
+}
+
+void benchBurst(uint8_t order) {
+  spidev.dataOrder = order;
+  uint32_t start = micros();
+  for (uint16_t i = 0; i < RUNS; i++) {
+    spidev.readBytes(0x3B, BURST, buffer);
+  }
+  report(order == LSBFIRST ? "readBytes x32 LSBFIRST" : "readBytes x32 MSBFIRST", micros() - start);
+  spidev.dataOrder = MSBFIRST;
+}
+
+#if defined(SPIDEV_FAULT_INJECTION) && defined(SPIDEV_CRC)
+// Effective throughput (good bytes per second) and worst-case latency of
+// CRC-protected reads under a fault profile
+void benchFaults(const char *name, uint16_t bitFlipRate, uint16_t stuckHighRate,
+                 uint16_t dropCSRate, uint16_t delayRate) {
+  SPIdevFaults profile = {};
+  profile.bitFlipRate = bitFlipRate;
+  profile.stuckHighRate = stuckHighRate;
+  profile.dropCSRate = dropCSRate;
+  profile.delayRate = delayRate;
+  profile.delayMicros = 500;
+  SPIdev::faults = profile;
+
+  uint32_t good = 0, worst = 0;
+  uint32_t start = micros();
+  for (uint16_t i = 0; i < RUNS; i++) {
+    uint32_t t = micros();
+    if (spidev.readBytesCRC(0x3B, BURST, buffer) > 0) good += BURST;
+    t = micros() - t;
+    if (t > worst) worst = t;
+  }
+  uint32_t elapsed = micros() - start;
+
+  Serial.print(name);
+  Serial.print(": ");
+  Serial.print(good * 1000000.0 / elapsed, 0);
+  Serial.print(" B/s, worst ");
+  Serial.print(worst);
+  Serial.print(" us, CRC errors ");
+  Serial.print(spidev.crcErrors);
+  Serial.print(", failures ");
+  Serial.println(spidev.crcFailures);
+
+  spidev.crcErrors = spidev.crcFailures = 0;
+  SPIdev::faults = SPIdevFaults();
+}
+#endif
+
+#ifdef SPIDEV_BUS_STATS
+void reportBus() {
+  SPIdevBusStats stats;
+  SPIdev::busStats(stats);
+  Serial.print("bus busy ");
+  Serial.print(100.0 * stats.busyMicros / stats.elapsedMicros, 1);
+  Serial.print(" %, ");
+  Serial.print(stats.bytes * 1000000.0 / stats.elapsedMicros, 0);
+  Serial.print(" B/s, ");
+  Serial.print(stats.transactions * 1000000.0 / stats.elapsedMicros, 0);
+  Serial.println(" transactions/s");
+  Serial.print("idle gaps (log2 us):");
+  for (uint8_t i = 0; i < SPIDEV_IDLE_GAP_BUCKETS; i++) {
+    Serial.print(" ");
+    Serial.print(stats.idleGaps[i]);
+  }
+  Serial.println();
+}
+#endif
+
+void setup() {
+  Serial.begin(115200);
+  reportFootprint();
+  benchReverse();
+  benchCRC();
+  benchSamplePath();
+  benchRegister();
+  benchSelect();
+  benchQueue();
+  benchBurst(MSBFIRST);
+  benchBurst(LSBFIRST);
+  benchWrite();
+#if defined(SPIDEV_FAULT_INJECTION) && defined(SPIDEV_CRC)
+  // the device must append a valid CRC-8 for the clean profile to succeed
+  benchFaults("clean", 0, 0, 0, 0);
+  benchFaults("bit flips 1e-3", 66, 0, 0, 0);
+  benchFaults("stuck MISO 1%", 0, 655, 0, 0);
+  benchFaults("dropped CS 1%", 0, 0, 655, 0);
+  benchFaults("delayed 5%", 0, 0, 0, 3277);
+#endif
+#ifdef SPIDEV_BUS_STATS
+  reportBus();
+#endif
+}
+
+void loop() {
+}
@@ -0,0 +1,44 @@
+#include "SPI.h"
+#include "SPIdev.h"
+#include "SPIdevDSP.h"
+
+// Reads the MPU6050 accelerometer at 8 kHz and decimates it to 200 Hz with a
+// third order CIC filter, in blocks of 40 samples.
+
+const uint32_t SPI_HS_CLOCK = 15000000; // 15 MHz
+SPISettings settings(SPI_HS_CLOCK, MSBFIRST, SPI_MODE3);
+SPIdev spidev(10, settings, MSBFIRST);
+
+const uint8_t ACCEL_OUT = 0x3B;
+const uint8_t BLOCK = 40;
+
+SPIdevDecimator decimator(3, BLOCK, 3);
+int16_t ax[BLOCK], ay[BLOCK], az[BLOCK];
+int16_t *const block[3] = { ax, ay, az };
+
+void setup() {
+  Serial.begin(115200);
+}
+
+void loop() {
+  static uint32_t next = micros();
+  uint16_t accel[3];
+
+  for (uint8_t i = 0; i < BLOCK; i++) {
+    while ((int32_t) (micros() - next) < 0);
+    next += 125; // 8 kHz
+    spidev.readWords(ACCEL_OUT, 3, accel);
+    ax[i] = accel[0];
+    ay[i] = accel[1];
+    az[i] = accel[2];
+  }
+
+  // filter in place, one 200 Hz sample comes out of each block
+  if (decimator.process(block, BLOCK, block) > 0) {
+    Serial.print(ax[0]);
+    Serial.print(" ");
+    Serial.print(ay[0]);
+    Serial.print(" ");
+    Serial.println(az[0]);
+  }
+}
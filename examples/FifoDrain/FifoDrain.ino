@@ -0,0 +1,45 @@
+#include "SPI.h"
+#include "SPIdev.h"
+#include "SPIdevFifo.h"
+
+// Drains the MPU6050 FIFO (accelerometer only, 1 kHz) just before it holds
+// 24 frames, and reports the frames lost to FIFO overflows or missed drains.
+
+const uint32_t SPI_HS_CLOCK = 1000000; // 1 MHz
+SPISettings settings(SPI_HS_CLOCK, MSBFIRST, SPI_MODE3);
+SPIdev spidev(10, settings, MSBFIRST);
+
+const uint8_t INT_STATUS = 0x3A;
+const uint8_t FIFO_OFLOW_INT = 4;
+const uint8_t FIFO_COUNTH = 0x72;
+const uint8_t FIFO_R_W = 0x74;
+const uint8_t FRAME = 6; // accelerometer X, Y, Z
+
+SPIdevFifo fifo(&spidev, FIFO_COUNTH, FIFO_R_W, FRAME, 1000);
+uint8_t buffer[FRAME * 32];
+SPIdevFifoScheduler scheduler(buffer, sizeof(buffer));
+
+void onFrames(void *context, const uint8_t *frames, uint16_t count, uint16_t lost) {
+  if (frames == NULL) {
+    Serial.print("gap: ");
+    Serial.print(lost);
+    Serial.println(" frames lost");
+    return;
+  }
+  // process count frames of FRAME bytes here
+}
+
+void setup() {
+  Serial.begin(115200);
+  fifo.setOverflowFlag(INT_STATUS, FIFO_OFLOW_INT);
+  fifo.setHandler(onFrames);
+  fifo.setWatermark(FRAME * 24);
+  scheduler.add(&fifo);
+}
+
+void loop() {
+  scheduler.service();
+
+  // other work here, a loop slower than the FIFO size now and then overflows it
+
+}
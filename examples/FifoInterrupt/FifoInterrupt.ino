@@ -0,0 +1,43 @@
+#include "SPI.h"
+#include "SPIdev.h"
+#include "SPIdevFifo.h"
+
+// Drains the MPU6050 FIFO (accelerometer only, 1 kHz) from its interrupt
+// line, no FIFO count is ever polled. Configure the sensor to raise INT on
+// its data-ready/watermark event and wire INT to pin 2.
+
+const uint32_t SPI_HS_CLOCK = 1000000; // 1 MHz
+SPISettings settings(SPI_HS_CLOCK, MSBFIRST, SPI_MODE3);
+SPIdev spidev(10, settings, MSBFIRST);
+
+const uint8_t FIFO_COUNTH = 0x72;
+const uint8_t FIFO_R_W = 0x74;
+const uint8_t FRAME = 6; // accelerometer X, Y, Z
+const uint8_t INT_PIN = 2;
+
+SPIdevFifo fifo(&spidev, FIFO_COUNTH, FIFO_R_W, FRAME, 1000);
+uint8_t ring[FRAME * 64];
+
+void setup() {
+  Serial.begin(115200);
+  if (!fifo.attachWatermarkInterrupt(ring, sizeof(ring), INT_PIN, RISING)) {
+    Serial.println("pin 2 has no interrupt");
+  }
+}
+
+void loop() {
+  uint8_t frame[FRAME];
+  uint16_t lost;
+  for (;;) {
+    uint16_t n = fifo.ringRead(frame, 1, &lost);
+    if (lost > 0) {
+      // frames missing from the stream before this point
+      Serial.print("gap: ");
+      Serial.print(lost);
+      Serial.println(" frames lost");
+    }
+    if (n == 0) break;
+    int16_t ax = (frame[0] << 8) | frame[1];
+    Serial.println(ax);
+  }
+}
@@ -14,7 +14,7 @@ void setup() {
 }
 
 void loop() {
-  spidev.readByte(ACCEL_OUT, data);
+  spidev.readByte(ACCEL_OUT, &data);
   Serial.println(data);
   delay(1000);
 }
@@ -0,0 +1,39 @@
+#include "SPI.h"
+#include "SPIdev.h"
+#include "SPIdevFifo.h"
+#include "SPIdevMetrics.h"
+
+// Drains the MPU6050 FIFO and writes the library metrics in the Prometheus
+// text format whenever a byte is received on the serial port, e.g. from a
+// gateway relaying scrapes. Enable SPIDEV_BUS_STATS and SPIDEV_CRC in
+// SPIdev.h to expose the bus and CRC metrics too.
+
+const uint32_t SPI_HS_CLOCK = 1000000; // 1 MHz
+SPISettings settings(SPI_HS_CLOCK, MSBFIRST, SPI_MODE3);
+SPIdev spidev(10, settings, MSBFIRST);
+
+const uint8_t FIFO_COUNTH = 0x72;
+const uint8_t FIFO_R_W = 0x74;
+const uint8_t FRAME = 6; // accelerometer X, Y, Z
+
+SPIdevFifo fifo(&spidev, FIFO_COUNTH, FIFO_R_W, FRAME, 1000);
+uint8_t buffer[FRAME * 32];
+SPIdevFifoScheduler scheduler(buffer, sizeof(buffer));
+SPIdevMetrics metrics;
+
+void setup() {
+  Serial.begin(115200);
+  fifo.setWatermark(FRAME * 24);
+  scheduler.add(&fifo);
+  metrics.add(&spidev, "mpu6050");
+  metrics.add(&fifo, "accel");
+}
+
+void loop() {
+  scheduler.service();
+
+  if (Serial.available() > 0) {
+    Serial.read();
+    metrics.print(Serial);
+  }
+}
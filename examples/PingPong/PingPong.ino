@@ -0,0 +1,44 @@
+#include "SPI.h"
+#include "SPIdev.h"
+#include "SPIdevPingPong.h"
+
+// Acquires MPU6050 accelerometer frames from its FIFO on the data-ready
+// interrupt while loop() prints the previous one. The MPU6050 has no FIFO
+// watermark interrupt, so every interrupt brings a single frame and each
+// buffer holds one. Configure the sensor to write the accelerometer to its
+// FIFO and raise INT on data ready, and wire INT to pin 2.
+
+const uint32_t SPI_HS_CLOCK = 1000000; // 1 MHz
+SPISettings settings(SPI_HS_CLOCK, MSBFIRST, SPI_MODE3);
+SPIdev spidev(10, settings, MSBFIRST);
+
+const uint8_t FIFO_R_W = 0x74;
+const uint8_t FRAME = 6; // accelerometer X, Y, Z
+const uint8_t INT_PIN = 2;
+
+uint8_t bufferA[FRAME];
+uint8_t bufferB[FRAME];
+SPIdevPingPong pingPong(bufferA, bufferB, sizeof(bufferA));
+
+void onDataReady() {
+  pingPong.fill(&spidev, FIFO_R_W);
+}
+
+void setup() {
+  Serial.begin(115200);
+  SPI.usingInterrupt(digitalPinToInterrupt(INT_PIN));
+  attachInterrupt(digitalPinToInterrupt(INT_PIN), onDataReady, RISING);
+}
+
+void loop() {
+  uint8_t *block = pingPong.available();
+  if (block == NULL) return;
+
+  int16_t ax = (block[0] << 8) | block[1];
+  pingPong.release();
+
+  Serial.print(ax);
+  Serial.print(" (overruns ");
+  Serial.print(pingPong.overruns);
+  Serial.println(")");
+}
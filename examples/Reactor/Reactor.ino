@@ -0,0 +1,65 @@
+#include "SPI.h"
+#include "SPIdev.h"
+#include "SPIdevFifo.h"
+#include "SPIdevWatcher.h"
+#include "SPIdevReactor.h"
+
+// Drives an MPU6050 from a single event loop: its FIFO is drained when due,
+// its interrupt status is watched, a button on pin 3 resets the FIFO and the
+// frame count is printed every second. Printing is deferred as a task, so it
+// only runs while no drain is due.
+
+const uint32_t SPI_HS_CLOCK = 1000000; // 1 MHz
+SPISettings settings(SPI_HS_CLOCK, MSBFIRST, SPI_MODE3);
+SPIdev spidev(10, settings, MSBFIRST);
+
+const uint8_t INT_STATUS = 0x3A;
+const uint8_t FIFO_COUNTH = 0x72;
+const uint8_t FIFO_R_W = 0x74;
+const uint8_t FRAME = 6; // accelerometer X, Y, Z
+const uint8_t BUTTON_PIN = 3;
+
+SPIdevFifo fifo(&spidev, FIFO_COUNTH, FIFO_R_W, FRAME, 1000);
+uint8_t buffer[FRAME * 32];
+SPIdevFifoScheduler scheduler(buffer, sizeof(buffer));
+SPIdevWatcher watcher(10, 500);
+SPIdevReactor reactor;
+
+void onStatus(void *context, SPIdev *dev, uint8_t regAddr, uint8_t value, uint8_t previous) {
+  Serial.print("INT_STATUS 0x");
+  Serial.println(value, HEX);
+}
+
+void onButton(void *context, uint8_t pin, uint8_t level) {
+  fifo.reset();
+}
+
+void print(void *context) {
+  Serial.print(fifo.frames);
+  Serial.print(" frames, ");
+  Serial.print(fifo.lostFrames);
+  Serial.println(" lost");
+}
+
+void report(void *context) {
+  reactor.defer(print);
+}
+
+void setup() {
+  Serial.begin(115200);
+  pinMode(BUTTON_PIN, INPUT_PULLUP);
+
+  fifo.setWatermark(FRAME * 24);
+  scheduler.add(&fifo);
+  watcher.setMaxSpan(1);
+  watcher.subscribe(&spidev, INT_STATUS, 0xFF, onStatus);
+
+  reactor.addSource(&scheduler);
+  reactor.addSource(&watcher);
+  reactor.onPin(BUTTON_PIN, FALLING, onButton);
+  reactor.every(1000, report);
+}
+
+void loop() {
+  reactor.service();
+}
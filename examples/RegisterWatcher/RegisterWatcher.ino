@@ -0,0 +1,37 @@
+#include "SPI.h"
+#include "SPIdev.h"
+#include "SPIdevWatcher.h"
+
+// Watches the interrupt status and the signal path reset registers of an
+// MPU6050, every 10 ms after a change and every 500 ms at most while nothing
+// changes. Registers closer together than the span are read in one burst.
+
+const uint32_t SPI_LS_CLOCK = 1000000;  // 1 MHz
+SPISettings settings(SPI_LS_CLOCK, MSBFIRST, SPI_MODE3);
+SPIdev spidev(10, settings, MSBFIRST);
+
+const uint8_t INT_STATUS = 0x3A;
+const uint8_t DATA_RDY_INT = 0x01;
+const uint8_t SIGNAL_PATH_RESET = 0x68;
+
+SPIdevWatcher watcher(10, 500);
+
+void onChange(void *context, SPIdev *dev, uint8_t regAddr, uint8_t value, uint8_t previous) {
+  Serial.print("0x");
+  Serial.print(regAddr, HEX);
+  Serial.print(": 0x");
+  Serial.print(previous, HEX);
+  Serial.print(" -> 0x");
+  Serial.println(value, HEX);
+}
+
+void setup() {
+  Serial.begin(115200);
+  watcher.setMaxSpan(1); // INT_STATUS is cleared on read, never burst across it
+  watcher.subscribe(&spidev, INT_STATUS, DATA_RDY_INT, onChange);
+  watcher.subscribe(&spidev, SIGNAL_PATH_RESET, 0x07, onChange);
+}
+
+void loop() {
+  watcher.service();
+}
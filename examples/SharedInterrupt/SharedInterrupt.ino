@@ -0,0 +1,57 @@
+#include "SPI.h"
+#include "SPIdev.h"
+#include "SPIdevIrq.h"
+
+// Two MPU6050 share one interrupt line on pin 2: their INT outputs are open
+// drain and active low, wired together. When the line is low, the interrupt
+// status of both is read, and each data-ready bit set calls the handler of
+// its device, which reads that device's accelerometer.
+
+const uint32_t SPI_LS_CLOCK = 1000000;  // 1 MHz
+SPISettings settings(SPI_LS_CLOCK, MSBFIRST, SPI_MODE3);
+SPIdev imuA(10, settings, MSBFIRST);
+SPIdev imuB(9, settings, MSBFIRST);
+
+const uint8_t INT_PIN_CFG = 0x37;
+const uint8_t INT_ENABLE = 0x38;
+const uint8_t INT_STATUS = 0x3A;
+const uint8_t ACCEL_XOUT_H = 0x3B;
+const uint8_t USER_CTRL = 0x6A;
+const uint8_t PWR_MGMT_1 = 0x6B;
+const uint8_t DATA_RDY_INT = 0;
+
+SPIdevIrqLine line(2, LOW);
+
+void configure(SPIdev &imu) {
+  imu.writeByte(PWR_MGMT_1, 0x01);   // wake up, gyro X clock
+  imu.writeByte(USER_CTRL, 0x10);    // SPI only
+  imu.writeByte(INT_PIN_CFG, 0xE0);  // active low, open drain, held until INT_STATUS is read
+  imu.writeByte(INT_ENABLE, 1 << DATA_RDY_INT);
+}
+
+void onDataReady(void *context, uint8_t source, uint8_t bitNum) {
+  SPIdev *imu = (SPIdev *) context;
+  uint16_t accel[3];
+  imu->readWords(ACCEL_XOUT_H, 3, accel);
+  Serial.print(source == 0 ? "A: " : "B: ");
+  Serial.print((int16_t) accel[0]);
+  Serial.print(" ");
+  Serial.print((int16_t) accel[1]);
+  Serial.print(" ");
+  Serial.println((int16_t) accel[2]);
+}
+
+void setup() {
+  Serial.begin(115200);
+  configure(imuA);
+  configure(imuB);
+
+  int8_t a = line.addSource(&imuA, INT_STATUS, &imuA);
+  int8_t b = line.addSource(&imuB, INT_STATUS, &imuB);
+  line.on(a, DATA_RDY_INT, onDataReady);
+  line.on(b, DATA_RDY_INT, onDataReady);
+}
+
+void loop() {
+  line.service();
+}
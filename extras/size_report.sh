@@ -0,0 +1,45 @@
+#!/bin/sh
+# SPIdev library collection - Footprint report
+# Builds a sketch once with the default options and once per compile-time
+# option, and prints the flash and RAM used by each build and its cost over
+# the default one.
+#
+# Usage: extras/size_report.sh [sketch]
+#   FQBN     board to build for (default arduino:avr:uno)
+#   OPTIONS  options to measure (default: every option in SPIdev.h)
+#
+# Requires arduino-cli with the core of the board installed.
+
+LIBRARY=$(cd "$(dirname "$0")/.." && pwd)
+SKETCH=${1:-$LIBRARY/examples/MPU6050_SPI_Raw}
+FQBN=${FQBN:-arduino:avr:uno}
+OPTIONS=${OPTIONS:-"SPIDEV_SOFT_LSBFIRST SPIDEV_CRC SPIDEV_FAULT_INJECTION SPIDEV_TRACE SPIDEV_BUS_STATS SPIDEV_SERIAL_DEBUG"}
+BUILD=$(mktemp -d)
+trap 'rm -rf "$BUILD"' EXIT
+
+# size <defines>: prints "<flash> <ram>" of a build with the given defines
+size() {
+    FLAGS=""
+    for d in $1; do FLAGS="$FLAGS -D$d"; done
+    arduino-cli compile --fqbn "$FQBN" --library "$LIBRARY" \
+        --build-path "$BUILD/$(echo "x$1" | tr ' ' '_')" \
+        --build-property "compiler.cpp.extra_flags=$FLAGS" "$SKETCH" 2>&1 |
+    awk '/^Sketch uses/ { flash = $3 } /^Global variables use/ { ram = $4 }
+         END { if (flash == "") exit 1; print flash, ram }'
+}
+
+BASE=$(size "") || { echo "default build failed" >&2; exit 1; }
+set -- $BASE
+BASE_FLASH=$1
+BASE_RAM=$2
+
+printf '%-24s %8s %8s %8s %8s\n' option flash delta ram delta
+printf '%-24s %8d %8s %8d %8s\n' default "$BASE_FLASH" - "$BASE_RAM" -
+for option in $OPTIONS; do
+    if SIZE=$(size "$option"); then
+        set -- $SIZE
+        printf '%-24s %8d %+8d %8d %+8d\n' "$option" "$1" $(($1 - BASE_FLASH)) "$2" $(($2 - BASE_RAM))
+    else
+        printf '%-24s %8s\n' "$option" failed
+    fi
+done
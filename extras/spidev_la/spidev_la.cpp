@@ -0,0 +1,478 @@
+// SPIdev library collection - Logic analyzer capture importer
+// Decodes sigrok/PulseView captures into SPIdev transactions and correlates
+// them with the library trace, to separate wire time from library overhead
+// 2020-05-03 by Rafael Carbonell <racarla96@gmail.com>
+//
+// Changelog:
+//      2020-05-?? - initial release
+
+/* ============================================
+SPIdev device library code
+
+MIT License
+
+Copyright (c) 2020 racarla96
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================
+*/
+
+/*
+    Host tool, not part of the Arduino library. Build with:
+        g++ -std=c++11 -O2 -o spidev_la spidev_la.cpp
+
+    Usage:
+        spidev_la [options] capture.(vcd|csv)
+            --cs NAME --sck NAME --mosi NAME --miso NAME
+                            channel names in the capture (default CS SCK MOSI MISO)
+            --mode N        SPI mode 0-3 (default 0)
+            --lsb           LSB-first bit order
+            --samplerate HZ CSV only: time rows by sample index instead of
+                            reading the time from the first column (seconds)
+            --trace FILE    SPIdev::printTrace JSON output to correlate with
+            --pin N         only correlate trace records of this track: the slave
+                            pin, or 256 * (strategy + 1) + address for devices
+                            on a chip-select strategy
+            --list          print every decoded transaction
+
+    Captures: VCD as exported by sigrok-cli (-O vcd) or PulseView, or CSV
+    with a header row naming the channels and one sample per row.
+*/
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Logic levels of the four SPI lines at a point in time (seconds)
+struct Sample {
+    double t;
+    int cs, sck, mosi, miso;
+};
+
+// Transaction decoded from the wires, from CS falling to CS rising
+struct Transaction {
+    double start, end;          // CS edges
+    double firstClock, lastClock;
+    vector<uint8_t> mosi, miso;
+    vector<double> byteStart;   // first sampling edge of each byte
+    vector<double> byteEnd;     // last sampling edge of each byte
+    vector<double> bitPeriods;  // sampling edge intervals within bytes
+};
+
+// Transaction recorded by the library (SPIDEV_TRACE), times in microseconds
+struct TraceRecord {
+    int pin;
+    int regAddr;
+    int bytes;
+    double ts, dur;
+};
+
+struct Options {
+    string cs = "CS", sck = "SCK", mosi = "MOSI", miso = "MISO";
+    int mode = 0;
+    bool lsb = false;
+    double samplerate = 0;
+    string trace;
+    int pin = -1;
+    bool list = false;
+};
+
+static void fail(const string &message) {
+    fprintf(stderr, "spidev_la: %s\n", message.c_str());
+    exit(1);
+}
+
+static string trim(const string &s) {
+    size_t a = s.find_first_not_of(" \t\r\n\"");
+    size_t b = s.find_last_not_of(" \t\r\n\"");
+    return (a == string::npos) ? "" : s.substr(a, b - a + 1);
+}
+
+// -----------------------------------------------------------------------------
+// Capture import
+// -----------------------------------------------------------------------------
+
+static vector<Sample> readCSV(const string &path, const Options &opt) {
+    ifstream in(path.c_str());
+    if (!in) fail("cannot open " + path);
+
+    vector<Sample> samples;
+    int col[4] = { -1, -1, -1, -1 };
+    const string *names[4] = { &opt.cs, &opt.sck, &opt.mosi, &opt.miso };
+    string line;
+    long row = 0;
+    while (getline(in, line)) {
+        line = trim(line);
+        if (line.empty() || line[0] == ';' || line[0] == '#') continue;
+
+        vector<string> cells;
+        stringstream ss(line);
+        string cell;
+        while (getline(ss, cell, ',')) cells.push_back(trim(cell));
+
+        if (col[0] < 0) {
+            // header row: locate the channels by name
+            for (size_t i = 0; i < cells.size(); i++) {
+                for (int c = 0; c < 4; c++) {
+                    if (cells[i] == *names[c]) col[c] = (int) i;
+                }
+            }
+            for (int c = 0; c < 4; c++) {
+                if (col[c] < 0) fail("channel " + *names[c] + " not in the CSV header");
+            }
+            continue;
+        }
+
+        Sample s;
+        s.t = (opt.samplerate > 0) ? row / opt.samplerate : atof(cells[0].c_str());
+        int *levels[4] = { &s.cs, &s.sck, &s.mosi, &s.miso };
+        for (int c = 0; c < 4; c++) {
+            if ((size_t) col[c] >= cells.size()) fail("short CSV row: " + line);
+            *levels[c] = atoi(cells[col[c]].c_str()) != 0;
+        }
+        samples.push_back(s);
+        row++;
+    }
+    return samples;
+}
+
+static vector<Sample> readVCD(const string &path, const Options &opt) {
+    ifstream in(path.c_str());
+    if (!in) fail("cannot open " + path);
+
+    map<string, int> ids;       // VCD identifier -> channel (0-3)
+    const string *names[4] = { &opt.cs, &opt.sck, &opt.mosi, &opt.miso };
+    double timescale = 1e-9;
+    vector<Sample> samples;
+    Sample current = { 0, 1, 0, 0, 0 };
+    bool definitions = true, pending = false;
+    string token;
+
+    while (in >> token) {
+        if (definitions) {
+            if (token == "$timescale") {
+                string value, unit;
+                in >> value;
+                // "1ns" or "1 ns"
+                size_t i = 0;
+                while (i < value.size() && isdigit((unsigned char) value[i])) i++;
+                unit = value.substr(i);
+                double n = atof(value.substr(0, i).c_str());
+                if (unit.empty()) in >> unit;
+                if (unit == "$end") fail("bad $timescale");
+                double scale = unit == "s" ? 1 : unit == "ms" ? 1e-3 : unit == "us" ? 1e-6
+                             : unit == "ns" ? 1e-9 : unit == "ps" ? 1e-12 : 1e-15;
+                timescale = n * scale;
+            } else if (token == "$var") {
+                string type, size, id, name;
+                in >> type >> size >> id >> name;
+                for (int c = 0; c < 4; c++) {
+                    if (name == *names[c]) ids[id] = c;
+                }
+            } else if (token == "$enddefinitions") {
+                definitions = false;
+                for (int c = 0; c < 4; c++) {
+                    bool found = false;
+                    for (map<string, int>::iterator it = ids.begin(); it != ids.end(); ++it) {
+                        found |= it->second == c;
+                    }
+                    if (!found) fail("channel " + *names[c] + " not in the VCD file");
+                }
+            }
+            continue;
+        }
+
+        if (token[0] == '#') {
+            if (pending) samples.push_back(current);
+            current.t = atof(token.c_str() + 1) * timescale;
+            pending = true;
+        } else if (token[0] == '0' || token[0] == '1') {
+            map<string, int>::iterator it = ids.find(token.substr(1));
+            if (it == ids.end()) continue;
+            int level = token[0] == '1';
+            switch (it->second) {
+                case 0: current.cs = level; break;
+                case 1: current.sck = level; break;
+                case 2: current.mosi = level; break;
+                case 3: current.miso = level; break;
+            }
+        }
+    }
+    if (pending) samples.push_back(current);
+    return samples;
+}
+
+// -----------------------------------------------------------------------------
+// SPI decoding
+// -----------------------------------------------------------------------------
+
+static vector<Transaction> decode(const vector<Sample> &samples, const Options &opt) {
+    vector<Transaction> transactions;
+    // modes 0 and 3 sample on the rising edge, modes 1 and 2 on the falling one
+    bool sampleOnRising = (opt.mode == 0 || opt.mode == 3);
+    Transaction t;
+    bool active = false;
+    int bits = 0, shiftMosi = 0, shiftMiso = 0;
+    double lastSampling = 0;
+
+    for (size_t i = 1; i < samples.size(); i++) {
+        const Sample &p = samples[i - 1];
+        const Sample &s = samples[i];
+
+        if (p.cs && !s.cs) {
+            t = Transaction();
+            t.start = s.t;
+            t.firstClock = t.lastClock = -1;
+            active = true;
+            bits = 0;
+            continue;
+        }
+        if (!active) continue;
+
+        if (p.sck != s.sck) {
+            if (t.firstClock < 0) t.firstClock = s.t;
+            t.lastClock = s.t;
+            bool rising = s.sck && !p.sck;
+            if (rising == sampleOnRising) {
+                if (bits == 0) {
+                    t.byteStart.push_back(s.t);
+                    shiftMosi = shiftMiso = 0;
+                } else {
+                    t.bitPeriods.push_back(s.t - lastSampling);
+                }
+                lastSampling = s.t;
+                if (opt.lsb) {
+                    shiftMosi |= s.mosi << bits;
+                    shiftMiso |= s.miso << bits;
+                } else {
+                    shiftMosi = (shiftMosi << 1) | s.mosi;
+                    shiftMiso = (shiftMiso << 1) | s.miso;
+                }
+                if (++bits == 8) {
+                    t.mosi.push_back((uint8_t) shiftMosi);
+                    t.miso.push_back((uint8_t) shiftMiso);
+                    t.byteEnd.push_back(s.t);
+                    bits = 0;
+                }
+            }
+        }
+
+        if (!p.cs && s.cs) {
+            t.end = s.t;
+            active = false;
+            if (t.firstClock < 0) t.firstClock = t.lastClock = t.start;
+            transactions.push_back(t);
+        }
+    }
+    return transactions;
+}
+
+// -----------------------------------------------------------------------------
+// Library trace import (output of SPIdev::printTrace)
+// -----------------------------------------------------------------------------
+
+static bool field(const string &object, const string &key, string &value) {
+    size_t k = object.find("\"" + key + "\":");
+    if (k == string::npos) return false;
+    k += key.size() + 3;
+    size_t e = object.find_first_of(",}", k);
+    value = trim(object.substr(k, e - k));
+    return true;
+}
+
+static vector<TraceRecord> readTrace(const string &path, int pin) {
+    ifstream in(path.c_str());
+    if (!in) fail("cannot open " + path);
+    stringstream ss;
+    ss << in.rdbuf();
+    string json = ss.str();
+
+    vector<TraceRecord> records;
+    size_t pos = 0;
+    while ((pos = json.find("{\"ph\":\"X\"", pos)) != string::npos) {
+        size_t end = json.find("}}", pos);
+        if (end == string::npos) break;
+        string object = json.substr(pos, end - pos + 2);
+        pos = end;
+
+        string name, tid, ts, dur, bytes;
+        if (!field(object, "name", name) || !field(object, "tid", tid) || !field(object, "ts", ts)
+            || !field(object, "dur", dur) || !field(object, "bytes", bytes)) continue;
+
+        TraceRecord r;
+        r.pin = atoi(tid.c_str());
+        if (pin >= 0 && r.pin != pin) continue;
+        // "read 0x3B" / "write 0x10"
+        size_t x = name.find("0x");
+        r.regAddr = (int) strtol(name.c_str() + x + 2, NULL, 16) | (name.compare(0, 4, "read") == 0 ? 0x80 : 0);
+        r.bytes = atoi(bytes.c_str());
+        r.ts = atof(ts.c_str());
+        r.dur = atof(dur.c_str());
+        records.push_back(r);
+    }
+    return records;
+}
+
+// -----------------------------------------------------------------------------
+// Report
+// -----------------------------------------------------------------------------
+
+struct Stats {
+    vector<double> values;
+
+    void add(double v) { values.push_back(v); }
+
+    void print(const char *name, double unit = 1e-6, const char *unitName = "us") {
+        printf("  %-28s", name);
+        if (values.empty()) {
+            printf("n/a\n");
+            return;
+        }
+        vector<double> v = values;
+        sort(v.begin(), v.end());
+        double sum = 0;
+        for (size_t i = 0; i < v.size(); i++) sum += v[i];
+        printf("avg %9.2f  min %9.2f  p50 %9.2f  p90 %9.2f  max %9.2f %s\n",
+               sum / v.size() / unit, v.front() / unit, v[v.size() / 2] / unit,
+               v[v.size() * 9 / 10] / unit, v.back() / unit, unitName);
+    }
+
+    double median() {
+        if (values.empty()) return 0;
+        vector<double> v = values;
+        nth_element(v.begin(), v.begin() + v.size() / 2, v.end());
+        return v[v.size() / 2];
+    }
+};
+
+int main(int argc, char **argv) {
+    Options opt;
+    string capture;
+    for (int i = 1; i < argc; i++) {
+        string a = argv[i];
+        bool value = i + 1 < argc;
+        if (a == "--cs" && value) opt.cs = argv[++i];
+        else if (a == "--sck" && value) opt.sck = argv[++i];
+        else if (a == "--mosi" && value) opt.mosi = argv[++i];
+        else if (a == "--miso" && value) opt.miso = argv[++i];
+        else if (a == "--mode" && value) opt.mode = atoi(argv[++i]) & 3;
+        else if (a == "--lsb") opt.lsb = true;
+        else if (a == "--samplerate" && value) opt.samplerate = atof(argv[++i]);
+        else if (a == "--trace" && value) opt.trace = argv[++i];
+        else if (a == "--pin" && value) opt.pin = atoi(argv[++i]);
+        else if (a == "--list") opt.list = true;
+        else if (a[0] != '-' && capture.empty()) capture = a;
+        else fail("unknown option " + a + " (see the comment at the top of spidev_la.cpp)");
+    }
+    if (capture.empty()) fail("no capture file given");
+
+    bool vcd = capture.size() > 4 && capture.compare(capture.size() - 4, 4, ".vcd") == 0;
+    vector<Sample> samples = vcd ? readVCD(capture, opt) : readCSV(capture, opt);
+    vector<Transaction> transactions = decode(samples, opt);
+    if (transactions.empty()) fail("no transaction found in " + capture);
+
+    Stats setup, hold, wire, asserted, byteGap, idle;
+    Stats bit;
+    for (size_t i = 0; i < transactions.size(); i++) {
+        for (size_t k = 0; k < transactions[i].bitPeriods.size(); k++) bit.add(transactions[i].bitPeriods[k]);
+    }
+    double bitPeriod = bit.median();
+
+    size_t bytes = 0;
+    for (size_t i = 0; i < transactions.size(); i++) {
+        Transaction &t = transactions[i];
+        bytes += t.mosi.size();
+        setup.add(t.firstClock - t.start);
+        hold.add(t.end - t.lastClock);
+        wire.add(t.lastClock - t.firstClock);
+        asserted.add(t.end - t.start);
+        // time between bytes beyond the nominal bit period: software pacing
+        for (size_t k = 1; k < t.byteStart.size(); k++) {
+            byteGap.add(max(0.0, t.byteStart[k] - t.byteEnd[k - 1] - bitPeriod));
+        }
+        if (i > 0) idle.add(t.start - transactions[i - 1].end);
+
+        if (opt.list) {
+            printf("%12.3f us  %7.2f us  ", t.start * 1e6, (t.end - t.start) * 1e6);
+            for (size_t k = 0; k < t.mosi.size(); k++) printf("%02X/%02X ", t.mosi[k], t.miso[k]);
+            printf("\n");
+        }
+    }
+
+    double span = transactions.back().end - transactions.front().start;
+    double busy = 0;
+    for (size_t i = 0; i < asserted.values.size(); i++) busy += asserted.values[i];
+
+    printf("%zu transactions, %zu bytes in %.3f ms\n", transactions.size(), bytes, span * 1e3);
+    printf("  SCK bit period              %.3f us (%.2f MHz)\n", bitPeriod * 1e6,
+           bitPeriod > 0 ? 1e-6 / bitPeriod : 0);
+    printf("  CS asserted                 %.1f %% of the time\n", span > 0 ? 100 * busy / span : 0);
+    printf("  wire efficiency             %.1f %% (clocked bits / CS-to-CS time)\n",
+           span > 0 ? 100 * bytes * 8 * bitPeriod / span : 0);
+    setup.print("CS setup (CS to first SCK)");
+    hold.print("CS hold (last SCK to CS)");
+    wire.print("wire time per transaction");
+    byteGap.print("extra gap between bytes");
+    idle.print("idle gap CS to CS");
+
+    if (opt.trace.empty()) return 0;
+
+    // match the library records in order, by register and length
+    vector<TraceRecord> records = readTrace(opt.trace, opt.pin);
+    Stats overhead, traceGap, wireGap;
+    size_t r = 0, matched = 0;
+    double offset = 0;
+    const TraceRecord *previous = NULL;
+    const Transaction *previousWire = NULL;
+    for (size_t i = 0; i < transactions.size() && r < records.size(); i++) {
+        const Transaction &t = transactions[i];
+        if (t.mosi.empty()) continue;
+        size_t j = r;
+        while (j < records.size() && !(records[j].regAddr == t.mosi[0] && records[j].bytes == (int) t.mosi.size() - 1)) j++;
+        if (j == records.size()) continue;
+        const TraceRecord &rec = records[j];
+        if (matched == 0) offset = t.start * 1e6 - rec.ts;
+
+        // library time around the transaction not spent with CS asserted
+        overhead.add((rec.dur - (t.end - t.start) * 1e6) * 1e-6);
+        if (previous != NULL) {
+            traceGap.add((rec.ts - previous->ts - previous->dur) * 1e-6);
+            wireGap.add(t.start - previousWire->end);
+        }
+        previous = &rec;
+        previousWire = &t;
+        r = j + 1;
+        matched++;
+    }
+
+    printf("%zu of %zu trace records matched (clock offset %.1f us)\n", matched, records.size(), offset);
+    overhead.print("library overhead per call");
+    traceGap.print("idle gap seen by library");
+    wireGap.print("idle gap on the wire");
+    return 0;
+}